@@ -64,6 +64,7 @@ linkParameters+=" -lGL -lm -lpng -lz -fsigned-char -pthread"
 
 srcs="
 basicset
+bitbase
 bitboard
 board
 boardmove
@@ -73,6 +74,7 @@ chessgame
 chessgamestate
 chessplayer
 debugset
+enginereader
 fontloader
 gamecore
 granitetheme
@@ -82,12 +84,16 @@ menuitem
 nicechess
 niceplayer
 objfile
+openingbook
 options
+pawnhashtable
 piece
 pieceset
 randomplayer
 texture
+thinkworker
 timer
+transpositiontable
 uciplayer
 utils
 xboardplayer
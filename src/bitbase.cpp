@@ -0,0 +1,809 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : bitbase.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#ifdef WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bitbase.h"
+
+using std::atomic;
+using std::string;
+using std::vector;
+
+static const char MAGIC[] = "NCBITBS1";
+static const int HEADER_SIZE = 8;
+static const int MAX_PIECES = 4;
+
+// Enough for a queen, a king and four promotions of a pawn
+static const int MAX_MOVES = 64;
+
+// Results as stored, two bits each, for the side to move
+static const int STORED_DRAW = 0;
+static const int STORED_WIN = 1;
+static const int STORED_LOSS = 2;
+
+/**
+ * The pieces of one ending, kings first. The color of the first king is
+ * the strong side, which is white in the tables, positions with black
+ * being the strong side are looked up with the colors swapped.
+ */
+struct Ending {
+  int count;
+  Piece::Color color[MAX_PIECES];
+  Piece::Type type[MAX_PIECES];
+  // Which piece is the pawn, -1 if there is none
+  int pawn;
+};
+
+// In the order they are solved, every ending only leads to those before
+static const Ending endings[Bitbase::ENDINGS] = {
+  { 3, { Piece::WHITE, Piece::BLACK, Piece::WHITE },
+       { Piece::KING, Piece::KING, Piece::QUEEN }, -1 },
+  { 3, { Piece::WHITE, Piece::BLACK, Piece::WHITE },
+       { Piece::KING, Piece::KING, Piece::ROOK }, -1 },
+  { 3, { Piece::WHITE, Piece::BLACK, Piece::WHITE },
+       { Piece::KING, Piece::KING, Piece::PAWN }, 2 },
+  { 4, { Piece::WHITE, Piece::BLACK, Piece::WHITE, Piece::WHITE },
+       { Piece::KING, Piece::KING, Piece::BISHOP, Piece::KNIGHT }, -1 },
+  { 4, { Piece::WHITE, Piece::BLACK, Piece::WHITE, Piece::BLACK },
+       { Piece::KING, Piece::KING, Piece::QUEEN, Piece::ROOK }, -1 },
+  { 4, { Piece::WHITE, Piece::BLACK, Piece::WHITE, Piece::BLACK },
+       { Piece::KING, Piece::KING, Piece::ROOK, Piece::PAWN }, 3 },
+};
+
+/**
+ * Pieces on squares, as the generator and the lookups see a position.
+ */
+struct Position {
+  int count;
+  int sq[MAX_PIECES];
+  Piece::Color color[MAX_PIECES];
+  Piece::Type type[MAX_PIECES];
+  Piece::Color turn;
+};
+
+// Applies one of the eight symmetries of the board to 'sq': bit 2 of 't'
+// mirrors along the a1-h8 diagonal, bit 0 the files and bit 1 the ranks.
+static inline int transform(int t, int sq)
+{
+  if(t & 4) {
+    sq = ((sq & 7) << 3) | (sq >> 3);
+  }
+  if(t & 1) {
+    sq ^= 7;
+  }
+  if(t & 2) {
+    sq ^= 56;
+  }
+  return sq;
+}
+
+/**
+ * Tables that squeeze the square of one piece into fewer bits. Without
+ * pawns the white king is moved into the a1-d1-d4 triangle, where a king
+ * on the diagonal can be mirrored either way. With a pawn only the files
+ * can be mirrored, and the pawn is moved to the a-d files.
+ */
+struct Symmetry {
+  int squares[8][64];
+  int triangle_index[64];
+  int triangle_square[10];
+  int king_transforms[64][2];
+  int king_transform_count[64];
+  int pawn_index[64];
+  int pawn_square[24];
+
+  Symmetry()
+  {
+    for(int t = 0; t < 8; t++) {
+      for(int sq = 0; sq < 64; sq++) {
+        squares[t][sq] = transform(t, sq);
+      }
+    }
+
+    int n = 0;
+    for(int sq = 0; sq < 64; sq++) {
+      int file = sq & 7;
+      int rank = sq >> 3;
+      triangle_index[sq] = -1;
+      if(file <= 3 && rank <= file) {
+        triangle_square[n] = sq;
+        triangle_index[sq] = n++;
+      }
+    }
+
+    for(int sq = 0; sq < 64; sq++) {
+      king_transform_count[sq] = 0;
+      for(int t = 0; t < 8; t++) {
+        if(triangle_index[transform(t, sq)] >= 0) {
+          king_transforms[sq][king_transform_count[sq]++] = t;
+        }
+      }
+    }
+
+    n = 0;
+    for(int sq = 0; sq < 64; sq++) {
+      pawn_index[sq] = -1;
+      if((sq & 7) <= 3 && sq >= 8 && sq < 56) {
+        pawn_square[n] = sq;
+        pawn_index[sq] = n++;
+      }
+    }
+  }
+};
+
+static const Symmetry & symmetry()
+{
+  static const Symmetry s;
+  return s;
+}
+
+static inline int keyPiece(const Ending & e)
+{
+  return (e.pawn >= 0) ? e.pawn : 0;
+}
+
+static unsigned long tableSize(const Ending & e)
+{
+  unsigned long size = (e.pawn >= 0) ? 24 : 10;
+
+  for(int i = 1; i < e.count; i++) {
+    size *= 64;
+  }
+
+  return size * 2;
+}
+
+static inline unsigned long tableBytes(const Ending & e)
+{
+  return (tableSize(e) + 3) / 4;
+}
+
+static inline unsigned long indexWith(const Ending & e, const int sq[], Piece::Color turn,
+                                     const int squares[], int key)
+{
+  unsigned long index = key;
+
+  for(int i = 0; i < e.count; i++) {
+    if(i != keyPiece(e)) {
+      index = index * 64 + squares[sq[i]];
+    }
+  }
+
+  return index * 2 + (turn == Piece::WHITE ? 0 : 1);
+}
+
+// Returns the index of the position with the pieces of 'e' on 'sq'. All
+// positions that are mirror images of each other share one index, the
+// lowest of their images.
+static unsigned long indexOf(const Ending & e, const int sq[], Piece::Color turn)
+{
+  const Symmetry & s = symmetry();
+
+  if(e.pawn >= 0) {
+    const int * squares = s.squares[((sq[e.pawn] & 7) >= 4) ? 1 : 0];
+    return indexWith(e, sq, turn, squares, s.pawn_index[squares[sq[e.pawn]]]);
+  }
+
+  unsigned long best = ULONG_MAX;
+  for(int i = 0; i < s.king_transform_count[sq[0]]; i++) {
+    const int * squares = s.squares[s.king_transforms[sq[0]][i]];
+    best = std::min(best, indexWith(e, sq, turn, squares, s.triangle_index[squares[sq[0]]]));
+  }
+
+  return best;
+}
+
+// The other way around, fills 'p' with the position of 'index'
+static void decode(const Ending & e, unsigned long index, Position & p)
+{
+  const Symmetry & s = symmetry();
+
+  p.count = e.count;
+  p.turn = (index & 1) ? Piece::BLACK : Piece::WHITE;
+  index >>= 1;
+
+  for(int i = e.count - 1; i >= 0; i--) {
+    p.color[i] = e.color[i];
+    p.type[i] = e.type[i];
+    if(i != keyPiece(e)) {
+      p.sq[i] = index & 63;
+      index >>= 6;
+    }
+  }
+
+  p.sq[keyPiece(e)] = (e.pawn >= 0) ? s.pawn_square[index] : s.triangle_square[index];
+}
+
+static inline int resultAt(const unsigned char * table, unsigned long index)
+{
+  return (table[index >> 2] >> (2 * (index & 3))) & 3;
+}
+
+static inline unsigned long long mask(int sq)
+{
+  return 1ULL << sq;
+}
+
+static unsigned long long attacks(Piece::Type t, Piece::Color c, int sq, unsigned long long occupied)
+{
+  switch(t) {
+    case Piece::PAWN:   return Board::pawnAttacks[c][sq];
+    case Piece::KNIGHT: return Board::knightAttacks[sq];
+    case Piece::BISHOP: return Board::bishopAttacks(sq, occupied);
+    case Piece::ROOK:   return Board::rookAttacks(sq, occupied);
+    case Piece::QUEEN:  return Board::queenAttacks(sq, occupied);
+    default:            return Board::kingAttacks[sq];
+  }
+}
+
+static unsigned long long occupied(const Position & p)
+{
+  unsigned long long occ = 0;
+
+  for(int i = 0; i < p.count; i++) {
+    occ |= mask(p.sq[i]);
+  }
+
+  return occ;
+}
+
+// Returns true if the king of color 'c' is attacked
+static bool isCheck(const Position & p, Piece::Color c)
+{
+  unsigned long long occ = occupied(p);
+  int king = -1;
+
+  for(int i = 0; i < p.count; i++) {
+    if(p.type[i] == Piece::KING && p.color[i] == c) {
+      king = p.sq[i];
+    }
+  }
+
+  for(int i = 0; i < p.count; i++) {
+    if(p.color[i] != c && (attacks(p.type[i], p.color[i], p.sq[i], occ) & mask(king))) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Returns true if no two pieces share a square, no pawn stands on the
+// first or last rank and the side that just moved is not in check
+static bool isValid(const Position & p)
+{
+  for(int i = 0; i < p.count; i++) {
+    if(p.type[i] == Piece::PAWN && (p.sq[i] < 8 || p.sq[i] >= 56)) {
+      return false;
+    }
+    for(int j = 0; j < i; j++) {
+      if(p.sq[i] == p.sq[j]) {
+        return false;
+      }
+    }
+  }
+
+  return !isCheck(p, Piece::opposite(p.turn));
+}
+
+// Fills 'out' with the positions after each legal move of the side to
+// move and returns how many there are. Captured pieces are taken out.
+static int successors(const Position & p, Position out[])
+{
+  static const Piece::Type promotions[4] = { Piece::QUEEN, Piece::ROOK, Piece::BISHOP, Piece::KNIGHT };
+  unsigned long long occ = occupied(p);
+  unsigned long long own = 0;
+  int n = 0;
+
+  for(int i = 0; i < p.count; i++) {
+    if(p.color[i] == p.turn) {
+      own |= mask(p.sq[i]);
+    }
+  }
+
+  for(int i = 0; i < p.count; i++) {
+    if(p.color[i] != p.turn) {
+      continue;
+    }
+
+    int from = p.sq[i];
+    unsigned long long targets;
+
+    if(p.type[i] == Piece::PAWN) {
+      int forward = (p.turn == Piece::WHITE) ? 8 : -8;
+      int start = (p.turn == Piece::WHITE) ? 1 : 6;
+      targets = Board::pawnAttacks[p.turn][from] & occ & ~own;
+      if(!(occ & mask(from + forward))) {
+        targets |= mask(from + forward);
+        if((from >> 3) == start && !(occ & mask(from + 2 * forward))) {
+          targets |= mask(from + 2 * forward);
+        }
+      }
+    } else {
+      targets = attacks(p.type[i], p.turn, from, occ) & ~own;
+    }
+
+    for(int to : BitBoard(targets)) {
+      Position q = p;
+      int mover = i;
+
+      for(int j = 0; j < q.count; j++) {
+        if(j != i && q.sq[j] == to) {
+          for(int k = j; k + 1 < q.count; k++) {
+            q.sq[k] = q.sq[k + 1];
+            q.color[k] = q.color[k + 1];
+            q.type[k] = q.type[k + 1];
+          }
+          q.count--;
+          mover -= (j < i);
+          break;
+        }
+      }
+      q.sq[mover] = to;
+
+      if(isCheck(q, p.turn)) {
+        continue;
+      }
+      q.turn = Piece::opposite(p.turn);
+
+      if(p.type[i] == Piece::PAWN && (to < 8 || to >= 56)) {
+        for(int k = 0; k < 4; k++) {
+          out[n] = q;
+          out[n++].type[mover] = promotions[k];
+        }
+      } else {
+        out[n++] = q;
+      }
+    }
+  }
+
+  return n;
+}
+
+// Fills 'out' with the positions from which a move of the side that just
+// moved, capturing and promoting nothing, leads to 'p'. Positions where
+// the side to move could take the king are included.
+static int predecessors(const Position & p, Position out[])
+{
+  Piece::Color mover = Piece::opposite(p.turn);
+  unsigned long long occ = occupied(p);
+  int n = 0;
+
+  for(int i = 0; i < p.count; i++) {
+    if(p.color[i] != mover) {
+      continue;
+    }
+
+    int to = p.sq[i];
+    unsigned long long origins;
+
+    if(p.type[i] == Piece::PAWN) {
+      int back = (mover == Piece::WHITE) ? -8 : 8;
+      int from = to + back;
+      origins = 0;
+      if(from >= 8 && from < 56 && !(occ & mask(from))) {
+        origins |= mask(from);
+        int doubleRank = (mover == Piece::WHITE) ? 3 : 4;
+        if((to >> 3) == doubleRank && !(occ & mask(from + back))) {
+          origins |= mask(from + back);
+        }
+      }
+    } else {
+      origins = attacks(p.type[i], mover, to, occ) & ~occ;
+    }
+
+    for(int from : BitBoard(origins)) {
+      out[n] = p;
+      out[n].sq[i] = from;
+      out[n++].turn = mover;
+    }
+  }
+
+  return n;
+}
+
+// Returns true if two moves from or to 'p' can lead to mirror images of
+// each other, which share one index and must be counted once. The
+// pieces neither move touches stay in place, so that takes all but two
+// pieces on one long diagonal, the only squares a mirroring keeps.
+static bool hasMirroredMoves(const Ending & e, const Position & p)
+{
+  int diagonal = 0;
+  int antiDiagonal = 0;
+
+  if(e.pawn >= 0) {
+    return false;
+  }
+
+  for(int i = 0; i < p.count; i++) {
+    diagonal += (p.sq[i] & 7) == (p.sq[i] >> 3);
+    antiDiagonal += (p.sq[i] & 7) + (p.sq[i] >> 3) == 7;
+  }
+
+  return std::max(diagonal, antiDiagonal) >= p.count - 2;
+}
+
+// Finds the ending of 'p' and the index of 'p' in its table. Returns the
+// ending, -1 if 'p' is none of them.
+static int locate(const Position & p, unsigned long & index)
+{
+  for(int e = 0; e < Bitbase::ENDINGS; e++) {
+    const Ending & end = endings[e];
+    if(end.count != p.count) {
+      continue;
+    }
+
+    for(int flip = 0; flip < 2; flip++) {
+      int sq[MAX_PIECES];
+      bool used[MAX_PIECES] = { false, false, false, false };
+      bool found = true;
+
+      for(int k = 0; k < end.count && found; k++) {
+        found = false;
+        for(int i = 0; i < p.count && !found; i++) {
+          Piece::Color c = flip ? Piece::opposite(p.color[i]) : p.color[i];
+          if(!used[i] && c == end.color[k] && p.type[i] == end.type[k]) {
+            used[i] = true;
+            sq[k] = flip ? (p.sq[i] ^ 56) : p.sq[i];
+            found = true;
+          }
+        }
+      }
+
+      if(found) {
+        index = indexOf(end, sq, flip ? Piece::opposite(p.turn) : p.turn);
+        return e;
+      }
+    }
+  }
+
+  return -1;
+}
+
+// Returns the stored result of 'p', which has left the ending being
+// solved. The endings not in the file it can get to are the bare kings,
+// a king and a minor piece against a king, which are draws, and the ones
+// after an underpromotion in KRKP, which are counted as draws.
+static int exitResult(const unsigned char * const tables[], const Position & p)
+{
+  unsigned long index;
+  int e = locate(p, index);
+
+  return (e < 0) ? STORED_DRAW : resultAt(tables[e], index);
+}
+
+// Generator state of a position besides its result: the number of moves
+// to other positions of the same ending not known to lose yet, and
+// whether some move leads to a draw in another ending
+static const unsigned char DRAW_EXIT = 0x80;
+
+enum SolveState { OPEN, SOLVED_WIN, SOLVED_LOSS, SOLVED_DRAW };
+
+// Solves ending 'e', the endings before it being in 'tables', and packs
+// the results into 'packed'
+static bool solve(int e, const unsigned char * const tables[], vector<unsigned char> & packed,
+                  const atomic<bool> * stop)
+{
+  const Ending & end = endings[e];
+  unsigned long size = tableSize(end);
+  vector<unsigned char> state(size, OPEN);
+  vector<unsigned char> counter(size, 0);
+  vector<unsigned int> queue;
+  Position p;
+  Position next[MAX_MOVES];
+  unsigned long indices[MAX_MOVES];
+
+  // Settle what can be told from the position itself: mates, stalemates
+  // and moves into other endings
+  for(unsigned long index = 0; index < size; index++) {
+    if(stop && (index & 0xffff) == 0 && stop->load()) {
+      return false;
+    }
+
+    decode(end, index, p);
+    if(!isValid(p) || indexOf(end, p.sq, p.turn) != index) {
+      state[index] = SOLVED_DRAW;
+      continue;
+    }
+
+    int n = successors(p, next);
+    int inside = 0;
+    bool isWin = false;
+    bool isDrawExit = false;
+    bool isMirrored = hasMirroredMoves(end, p);
+
+    for(int i = 0; i < n; i++) {
+      bool isSameEnding = next[i].count == p.count;
+      for(int j = 0; j < p.count && isSameEnding; j++) {
+        isSameEnding = next[i].type[j] == p.type[j];
+      }
+
+      if(isSameEnding && !isMirrored) {
+        inside++;
+      } else if(isSameEnding) {
+        unsigned long k = indexOf(end, next[i].sq, next[i].turn);
+        if(std::find(indices, indices + inside, k) == indices + inside) {
+          indices[inside++] = k;
+        }
+      } else {
+        int result = exitResult(tables, next[i]);
+        isWin = isWin || result == STORED_LOSS;
+        isDrawExit = isDrawExit || result == STORED_DRAW;
+      }
+    }
+
+    if(isWin) {
+      state[index] = SOLVED_WIN;
+      queue.push_back(index);
+    } else if(n == 0) {
+      state[index] = isCheck(p, p.turn) ? SOLVED_LOSS : SOLVED_DRAW;
+      if(state[index] == SOLVED_LOSS) {
+        queue.push_back(index);
+      }
+    } else if(inside == 0) {
+      state[index] = isDrawExit ? SOLVED_DRAW : SOLVED_LOSS;
+      if(!isDrawExit) {
+        queue.push_back(index);
+      }
+    } else {
+      counter[index] = inside | (isDrawExit ? DRAW_EXIT : 0);
+    }
+  }
+
+  // Pass results back: whatever moves into a lost position is won, and
+  // what only moves into won ones is lost
+  for(unsigned long q = 0; q < queue.size(); q++) {
+    if(stop && (q & 0xffff) == 0 && stop->load()) {
+      return false;
+    }
+
+    unsigned long index = queue[q];
+    bool isLoss = state[index] == SOLVED_LOSS;
+    int count = 0;
+
+    decode(end, index, p);
+    int n = predecessors(p, next);
+
+    bool isMirrored = hasMirroredMoves(end, p);
+    for(int i = 0; i < n; i++) {
+      unsigned long k = indexOf(end, next[i].sq, next[i].turn);
+      if(!isMirrored || std::find(indices, indices + count, k) == indices + count) {
+        indices[count++] = k;
+      }
+    }
+
+    for(int i = 0; i < count; i++) {
+      unsigned long k = indices[i];
+      if(state[k] != OPEN) {
+        continue;
+      }
+
+      if(isLoss) {
+        state[k] = SOLVED_WIN;
+        queue.push_back(k);
+      } else if(--counter[k] == 0) {
+        state[k] = SOLVED_LOSS;
+        queue.push_back(k);
+      }
+    }
+  }
+
+  // Open positions are draws, those with a draw exit never reach zero
+  packed.assign(tableBytes(end), 0);
+  for(unsigned long index = 0; index < size; index++) {
+    int result = (state[index] == SOLVED_WIN) ? STORED_WIN :
+                 (state[index] == SOLVED_LOSS) ? STORED_LOSS : STORED_DRAW;
+    packed[index >> 2] |= result << (2 * (index & 3));
+  }
+
+  return true;
+}
+
+Bitbase::Bitbase()
+  : m_data(NULL), m_length(0)
+{
+  for(int e = 0; e < ENDINGS; e++) {
+    m_tables[e] = NULL;
+  }
+}
+
+Bitbase::~Bitbase()
+{
+  close();
+}
+
+bool Bitbase::open(const string & filename)
+{
+  unsigned long expected = HEADER_SIZE;
+
+  close();
+
+  for(int e = 0; e < ENDINGS; e++) {
+    expected += tableBytes(endings[e]);
+  }
+
+#ifdef WIN32
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if(!in) {
+    return false;
+  }
+  m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  if(m_buffer.size() != expected || memcmp(&m_buffer[0], MAGIC, HEADER_SIZE)) {
+    m_buffer.clear();
+    return false;
+  }
+  m_data = &m_buffer[0];
+  m_length = m_buffer.size();
+#else
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (unsigned long)st.st_size != expected) {
+    ::close(fd);
+    return false;
+  }
+
+  void * data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(data == MAP_FAILED) {
+    return false;
+  }
+
+  m_data = (const unsigned char *)data;
+  m_length = st.st_size;
+
+  if(memcmp(m_data, MAGIC, HEADER_SIZE)) {
+    close();
+    return false;
+  }
+#endif
+
+  const unsigned char * table = m_data + HEADER_SIZE;
+  for(int e = 0; e < ENDINGS; e++) {
+    m_tables[e] = table;
+    table += tableBytes(endings[e]);
+  }
+
+  return true;
+}
+
+void Bitbase::close()
+{
+#ifdef WIN32
+  m_buffer.clear();
+#else
+  if(m_data) {
+    munmap((void *)m_data, m_length);
+  }
+#endif
+
+  m_data = NULL;
+  m_length = 0;
+  for(int e = 0; e < ENDINGS; e++) {
+    m_tables[e] = NULL;
+  }
+}
+
+Bitbase::Result Bitbase::probe(const Board & board) const
+{
+  unsigned long long occ = board.getOccupied();
+
+  if(!m_data || BitBoard::popcount(occ) > MAX_PIECES) {
+    return UNKNOWN;
+  }
+
+  // A pawn on the first or last rank, as an illegal FEN can set up, has
+  // no pawn index and would be looked up outside the tables
+  static const unsigned long long backRanks = 0xff000000000000ffULL;
+  if(board.m_pieces[Piece::PAWN] & backRanks) {
+    return UNKNOWN;
+  }
+
+  // A castling right needs both the king and the rook flag
+  static const unsigned long long kings = mask(4) | mask(60);
+  static const unsigned long long rooks = mask(0) | mask(7) | mask(56) | mask(63);
+  if((board.m_castling_flags & kings) && (board.m_castling_flags & rooks)) {
+    return UNKNOWN;
+  }
+
+  Position p;
+  p.count = 0;
+  p.turn = board.getSideToMove();
+  for(int sq : BitBoard(occ)) {
+    p.sq[p.count] = sq;
+    p.color[p.count] = (board.m_color[Piece::WHITE] & mask(sq)) ? Piece::WHITE : Piece::BLACK;
+    p.type[p.count] = board.typeAt(sq);
+    p.count++;
+  }
+
+  unsigned long index;
+  int e = locate(p, index);
+  if(e < 0) {
+    return UNKNOWN;
+  }
+
+  switch(resultAt(m_tables[e], index)) {
+    case STORED_WIN:  return WIN;
+    case STORED_LOSS: return LOSS;
+    default:          return DRAW;
+  }
+}
+
+bool Bitbase::generate(const string & filename, const atomic<bool> * stop)
+{
+  // One at a time, two players sharing a file would both write it
+  static std::mutex generating;
+  std::unique_lock<std::mutex> lock(generating, std::defer_lock);
+  while(!lock.try_lock()) {
+    if(stop && stop->load()) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  Bitbase existing;
+  if(existing.open(filename)) {
+    return true;
+  }
+
+  vector<unsigned char> packed[ENDINGS];
+  const unsigned char * tables[ENDINGS];
+  bool isDone = true;
+
+  for(int e = 0; e < ENDINGS && isDone; e++) {
+    isDone = solve(e, tables, packed[e], stop);
+    if(isDone) {
+      tables[e] = &packed[e][0];
+    }
+  }
+
+  // Written under another name first, so that nobody maps half a file
+  string temporary = filename + ".tmp";
+  if(isDone) {
+    std::ofstream out(temporary.c_str(), std::ios::binary);
+    out.write(MAGIC, HEADER_SIZE);
+    for(int e = 0; e < ENDINGS; e++) {
+      out.write((const char *)&packed[e][0], packed[e].size());
+    }
+    out.close();
+    isDone = (bool)out;
+  }
+
+  if(isDone) {
+#ifdef WIN32
+    remove(filename.c_str());
+#endif
+    isDone = rename(temporary.c_str(), filename.c_str()) == 0;
+  }
+  if(!isDone) {
+    remove(temporary.c_str());
+  }
+
+  return isDone;
+}
+
+// End of file bitbase.cpp
@@ -0,0 +1,84 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : bitbase.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+/**
+ * Win, draw or loss of every position of the endings KPK, KRK, KQK,
+ * KBNK, KRKP and KQKR, the last one needed by KRKP for the pawn
+ * promoting. Each ending is solved by retrograde analysis: mates and
+ * captures into a smaller ending are settled first, and from there
+ * results are passed back move by move until nothing changes. What is
+ * left is a draw.
+ *
+ * Results take two bits per position, kept in one file of about 6 MB
+ * that is written once by generate() and memory mapped by open(). The
+ * tables only hold one side of each ending, with the white king, or the
+ * pawn, moved to one part of the board by mirroring.
+ *
+ * Underpromotions in KRKP count as draws, as the endings they lead to
+ * are not part of the file. All other results are exact, castling and
+ * the fifty move rule left aside.
+ */
+class Bitbase {
+ public:
+  /** The value of a position for the side to move. */
+  enum Result { UNKNOWN = -2, LOSS = -1, DRAW = 0, WIN = 1 };
+
+  Bitbase();
+  ~Bitbase();
+
+  /**
+   * Maps the bitbase file 'filename', closing the one opened before.
+   * Returns false if the file can not be read or is no bitbase.
+   */
+  bool open(const std::string & filename);
+
+  /** Unmaps the file. */
+  void close();
+
+  bool isOpen() const
+    { return m_data != NULL; }
+
+  /**
+   * Looks up the position of 'board'. Returns UNKNOWN if its material is
+   * not one of the endings covered, a castling right is left or no file
+   * is open.
+   */
+  Result probe(const Board & board) const;
+
+  /**
+   * Solves all the endings and writes them to 'filename'. Takes several
+   * seconds. Calls at the same time run one after the other, and do
+   * nothing if an earlier one already wrote the file. Returns false if
+   * the file can not be written or 'stop' is set while generating.
+   */
+  static bool generate(const std::string & filename, const std::atomic<bool> * stop = NULL);
+
+  /** Number of endings in the file. */
+  const static int ENDINGS = 6;
+
+ private:
+  const unsigned char * m_data;
+  unsigned long m_length;
+  const unsigned char * m_tables[ENDINGS];
+#ifdef WIN32
+  std::vector<unsigned char> m_buffer;
+#endif
+};
+
+#endif
+
+// End of file bitbase.h
@@ -12,6 +12,12 @@
 #include "boardposition.h"
 #include <iosfwd>
 
+// Without POPCNT (see CPU_FLAGS in the Makefile) the builtin would be a
+// library call on x86, slower than counting the bits inline
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__POPCNT__)
+#define NICECHESS_POPCNT_PORTABLE
+#endif
+
 /**
  * This class represents a bit board.
  */
@@ -55,10 +61,120 @@ class BitBoard {
   unsigned long long getBoard() const
     { return m_board; }
 
+  /**
+   * Walks the set squares of a BitBoard from a1 to h8, so that
+   * 'for(int sq : BitBoard(b))' visits every square of 'b'.
+   */
+  class Iterator {
+   public:
+    Iterator(unsigned long long board) : m_bits(board) {}
+
+    int operator*() const
+      { return lsb(m_bits); }
+
+    Iterator & operator++()
+      { m_bits &= m_bits - 1; return *this; }
+
+    bool operator!=(const Iterator & it) const
+      { return m_bits != it.m_bits; }
+
+   private:
+    unsigned long long m_bits;
+  };
+
+  Iterator begin() const
+    { return Iterator(m_board); }
+
+  Iterator end() const
+    { return Iterator(0LL); }
+
+  /** Returns the number of set squares. */
+  int count() const
+    { return popcount(m_board); }
+
+  /** Returns the number of set bits of 'b'. */
+  static inline int popcount(unsigned long long b);
+
+  /** Returns the lowest set square of 'b', which must not be empty. */
+  static inline int lsb(unsigned long long b);
+
+  /** Clears the lowest set square of 'b' and returns it. */
+  static inline int popLsb(unsigned long long & b)
+    { int sq = lsb(b); b &= b - 1; return sq; }
+
+  static const unsigned long long FILE_A = 0x0101010101010101ULL;
+  static const unsigned long long FILE_H = 0x8080808080808080ULL;
+
+  /** Returns the squares of 'b' moved one rank up, towards rank 8. */
+  static inline unsigned long long north(unsigned long long b)
+    { return b << 8; }
+
+  /** Returns the squares of 'b' moved one rank down, towards rank 1. */
+  static inline unsigned long long south(unsigned long long b)
+    { return b >> 8; }
+
+  /** Returns the squares of 'b' moved one file towards h. */
+  static inline unsigned long long east(unsigned long long b)
+    { return (b << 1) & ~FILE_A; }
+
+  /** Returns the squares of 'b' moved one file towards a. */
+  static inline unsigned long long west(unsigned long long b)
+    { return (b >> 1) & ~FILE_H; }
+
+  /** Returns the squares of 'b' and all squares above them. */
+  static inline unsigned long long northFill(unsigned long long b)
+    { b |= b << 8; b |= b << 16; return b | (b << 32); }
+
+  /** Returns the squares of 'b' and all squares below them. */
+  static inline unsigned long long southFill(unsigned long long b)
+    { b |= b >> 8; b |= b >> 16; return b | (b >> 32); }
+
+  /** Returns every file with a square set in 'b'. */
+  static inline unsigned long long fileFill(unsigned long long b)
+    { return northFill(b) | southFill(b); }
+
  private:
+  static inline int popcountPortable(unsigned long long b);
+
   unsigned long long m_board;
 };
 
+// With POPCNT enabled at compile time, or on other processors, the
+// builtin is a single instruction.
+inline int BitBoard::popcount(unsigned long long b)
+{
+#if defined(__GNUC__) && !defined(NICECHESS_POPCNT_PORTABLE)
+  return __builtin_popcountll(b);
+#else
+  return popcountPortable(b);
+#endif
+}
+
+inline int BitBoard::popcountPortable(unsigned long long b)
+{
+  b = b - ((b >> 1) & 0x5555555555555555ULL);
+  b = (b & 0x3333333333333333ULL) + ((b >> 2) & 0x3333333333333333ULL);
+  b = (b + (b >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (int)((b * 0x0101010101010101ULL) >> 56);
+}
+
+// GCC emits 'rep bsf' here, which BMI1 processors run as TZCNT and
+// older ones as BSF, so no run time check is needed.
+inline int BitBoard::lsb(unsigned long long b)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(b);
+#else
+  static const int debruijn[64] = {
+     0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+  };
+  return debruijn[((b & (0 - b)) * 0x03f79d71b4cb0a89ULL) >> 58];
+#endif
+}
+
 std::ostream& operator<< (std::ostream & os, const BitBoard & b);
 
 #endif
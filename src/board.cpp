@@ -6,6 +6,7 @@
  * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
  **************************************************************************/
 
+#include <cstring>
 #include <iostream>
 #include <vector>
 
@@ -21,10 +22,76 @@ using std::vector;
 unsigned long long Board::pawnAttacks[2][64];
 unsigned long long Board::knightAttacks[64];
 unsigned long long Board::kingAttacks[64];
-unsigned long long Board::rankAttacks[64][256];
-unsigned long long Board::fileAttacks[64][256];
-unsigned long long Board::diagAttacksSE[64][256];
-unsigned long long Board::diagAttacksNE[64][256];
+
+Board::Magic Board::m_rook_magics[64];
+Board::Magic Board::m_bishop_magics[64];
+unsigned long long Board::m_rook_table[0x19000];
+unsigned long long Board::m_bishop_table[0x1480];
+bool Board::m_use_pext = false;
+Board::SliderAttacks Board::m_rook_attacks = Board::rookMagicAttacks;
+Board::SliderAttacks Board::m_bishop_attacks = Board::bishopMagicAttacks;
+unsigned long long Board::m_between[64][64];
+
+unsigned long long Board::m_zobrist_pieces[2][6][64];
+unsigned long long Board::m_zobrist_castling[64];
+unsigned long long Board::m_zobrist_enpassant[8];
+unsigned long long Board::m_zobrist_side;
+
+const int Board::m_piece_value[Piece::LAST_TYPE + 1] = { 100, 500, 310, 325, 900, 0 };
+int Board::m_psq_middlegame_table[2][6][64];
+int Board::m_psq_endgame_table[2][6][64];
+
+// Piece-square values from white's side of the board, a1 first. Black
+// uses them mirrored. Rooks and queens have none.
+static const int bishopSquares[64] = {
+  -5,-5,-5,-5,-5,-5,-5,-5,
+  -5,10,5,10,10,5,10,-5,
+  -5,5,3,12,12,3,5,-5,
+  -5,3,12,3,3,12,3,-5,
+  -5,3,12,3,3,12,3,-5,
+  -5,5,3,12,12,3,5,-5,
+  -5,10,5,10,10,5,10,-5,
+  -5,-5,-5,-5,-5,-5,-5,-5 };
+
+static const int knightSquares[64] = {
+  -10,-5,-5,-5,-5,-5,-5,-10,
+  -5,0,0,3,3,0,0,-5,
+  -5,0,5,5,5,5,0,-5,
+  -5,0,5,10,10,5,0,-5,
+  -5,0,5,10,10,5,0,-5,
+  -5,0,5,5,5,5,0,-5,
+  -5,0,0,3,3,0,0,-5,
+  -10,-5,-5,-5,-5,-5,-5,-10 };
+
+static const int pawnSquares[64] = {
+  0,0,0,0,0,0,0,0,
+  0,0,0,-5,-5,0,0,0,
+  1,2,3,4,4,3,2,1,
+  2,4,6,8,8,6,4,2,
+  3,6,9,12,12,9,6,3,
+  4,8,12,16,16,12,8,4,
+  5,10,15,20,20,15,10,5,
+  0,0,0,0,0,0,0,0 };
+
+static const int kingSquares[64] = {
+  2,10,4,0,0,7,10,2,
+  -3,-3,-5,-5,-5,-5,-3,-3,
+  -5,-5,-8,-8,-8,-8,-5,-5,
+  -8,-8,-13,-13,-13,-13,-8,-8,
+  -13,-13,-21,-21,-21,-21,-13,-13,
+  -21,-21,-34,-34,-34,-34,-21,-21,
+  -34,-34,-55,-55,-55,-55,-34,-34,
+  -55,-55,-89,-89,-89,-89,-55,-55};
+
+static const int endgameKingSquares[64] = {
+  -5,-3,-1,0,0,-1,-3,-5,
+  -3,5,5,5,5,5,5,-3,
+  -1,5,10,10,10,10,5,-1,
+  0,5,10,15,15,10,5,0,
+  0,5,10,15,15,10,5,0,
+  -1,5,10,10,10,10,5,-1,
+  -3,5,5,5,5,5,5,-3,
+  -5,-3,-1,0,0,-1,-3,-5};
 
 Piece* Board::m_allpieces[Piece::LAST_COLOR + 1][Piece::LAST_TYPE + 1];
 bool Board::m_setup = false;
@@ -53,11 +120,21 @@ void Board::reset()
      m_piece_count[Piece::BLACK][i] = 0;
   }
 
+  for (int i=0; i < BOARDSIZE*BOARDSIZE; i++) {
+    m_mailbox[i] = EMPTY_SQUARE;
+  }
+
   // Hex value to initialize the appropriate castling flags
   m_castling_flags = 0x9100000000000091LL;
   m_enpassant_flags = 0LL;
+  m_side_to_move = Piece::WHITE;
+  m_hash = castlingKey(m_castling_flags);
   m_total_pieces[Piece::WHITE] = 0;
   m_total_pieces[Piece::BLACK] = 0;
+  m_psq_middlegame = 0;
+  m_psq_endgame = 0;
+  m_material = 0;
+  m_pawn_hash = 0LL;
 }
 
 void Board::setupPieces()
@@ -74,24 +151,13 @@ void Board::setupPieces()
 // Returns the Piece at BoardPosition 'bp'.
 Piece* Board::getPiece(const BoardPosition & bp) const
 {
-  if(!isOccupied(bp)) {
-    return NULL;
-  }
-
-  unsigned long long mask = getMask(bp);
-  Piece::Color color;
+  unsigned char code = m_mailbox[bp.hash()];
 
-  color = m_color[Piece::WHITE] & mask ? Piece::WHITE : Piece::BLACK;
-  // TODO - What happens its not present, see above.
-
-  for (int i = 0; i <= Piece::LAST_TYPE; i++) {
-    if (m_pieces[i] & mask) {
-      return m_allpieces[color][i];
-    }
+  if(code == EMPTY_SQUARE) {
+    return NULL;
   }
 
-  // Should never get here.
-  return NULL;
+  return m_allpieces[code >> 3][code & 7];
 }
 
 // Sets the boardposition to piece p of type t
@@ -106,6 +172,9 @@ void Board::setPiece(Piece::Color c, Piece::Type t, const BoardPosition& bp)
 
   setBit(m_pieces[t], bp);
   setBit(m_color[c], bp);
+  m_mailbox[bp.hash()] = pieceCode(c, t);
+  m_hash ^= m_zobrist_pieces[c][t][bp.hash()];
+  updatePsq(c, t, bp.hash(), 1);
 
   if(t == Piece::KING) {
     m_king_pos[c] = bp;
@@ -125,6 +194,9 @@ void Board::setPiece(Piece * piece, const BoardPosition & bp)
     
   setBit(m_pieces[piece->m_type], bp);
   setBit(m_color[piece->m_color], bp);
+  m_mailbox[bp.hash()] = pieceCode(piece->m_color, piece->m_type);
+  m_hash ^= m_zobrist_pieces[piece->m_color][piece->m_type][bp.hash()];
+  updatePsq(piece->m_color, piece->m_type, bp.hash(), 1);
 
   if(piece->m_type == Piece::KING) {
     m_king_pos[piece->m_color] = bp;
@@ -289,13 +361,11 @@ bool Board::isMoveLegal(const BoardMove & bm) const
             break;
         case Piece::QUEEN:
         case Piece::BISHOP:
-            attack |= diagAttacksSE[bp.hash()][getSEDiagState(bp)];
-            attack |= diagAttacksNE[bp.hash()][getNEDiagState(bp)];
+            attack |= bishopAttacks(bp.hash(), getOccupied());
             if(type == Piece::BISHOP)
                 break;
         case Piece::ROOK:
-            attack |= rankAttacks[bp.hash()][getRankState(bp)];
-            attack |= fileAttacks[bp.hash()][getFileState(bp)];
+            attack |= rookAttacks(bp.hash(), getOccupied());
             break;
     }
     */
@@ -310,34 +380,12 @@ bool Board::isMoveLegal(const BoardMove & bm) const
 
 unsigned long long Board::isAttacked(const BoardPosition& bp, Piece::Color c) const
 {
-  Piece::Color attacker = Piece::opposite(c);
-  int pos = bp.hash();
-  int rank = getRankState(bp);
-  int file = getFileState(bp);
-  int diagSE = getSEDiagState(bp);
-  int diagNE = getNEDiagState(bp);
-
-  unsigned long long board = 0LL;
-  board |= pawnAttacks[c][pos] & m_pieces[Piece::PAWN] & m_color[attacker];
-  board |= knightAttacks[pos] & m_pieces[Piece::KNIGHT] & m_color[attacker];
-  board |= kingAttacks[pos] & m_pieces[Piece::KING] & m_color[attacker];
-  board |= rankAttacks[pos][rank] & m_pieces[Piece::ROOK] & m_color[attacker];
-  board |= rankAttacks[pos][rank] & m_pieces[Piece::QUEEN] & m_color[attacker];
-  board |= fileAttacks[pos][file] & m_pieces[Piece::ROOK] & m_color[attacker];
-  board |= fileAttacks[pos][file] & m_pieces[Piece::QUEEN] & m_color[attacker];
-  board |= diagAttacksSE[pos][diagSE] & m_pieces[Piece::BISHOP] & m_color[attacker];
-  board |= diagAttacksSE[pos][diagSE] & m_pieces[Piece::QUEEN] & m_color[attacker];
-  board |= diagAttacksNE[pos][diagNE] & m_pieces[Piece::BISHOP] & m_color[attacker];
-  board |= diagAttacksNE[pos][diagNE] & m_pieces[Piece::QUEEN] & m_color[attacker];
-
-  return board;
+  return attackersTo(bp.hash(), c, getOccupied());
 }
 
 bool Board::isResultCheck(const BoardMove& bm) const
 {
-  Board board = *this;
-  board.update(bm);
-  return board.isCheck(bm.getPiece()->color());
+  return isCheckAfter(toMove(bm), bm.getPiece()->color());
 }
 
 bool Board::isCheckMate(Piece::Color c) const
@@ -408,317 +456,624 @@ bool Board::isMaterialDraw() const
   return true;
 }
 
-vector<BoardMove> Board::possibleMoves(Piece::Color c, bool findOne) const
+// Adds a move from 'from' to every square set in 'targets'.
+static inline void addMoves(MoveList & moves, int from, unsigned long long targets)
 {
-  vector<BoardPosition> pos;
-  vector<BoardMove> goodMoves, trialMoves;
-  
-  // Find all of this players pieces
-  for(int i=0; i < BOARDSIZE*BOARDSIZE; i++) {
-    if((m_color[c] >> i) & 1)
-      pos.push_back(BoardPosition(i));
+  for(int to : BitBoard(targets)) {
+    moves.push(Move(from, to));
   }
+}
 
-  // Find all possible move for each piece
-  for(int i=0; i < pos.size(); i++) {
-    Piece* p = getPiece(pos[i]);
-    BoardPosition bp;
+// A captured piece still stands in m_pieces, so it is taken out of the
+// attackers found. Pieces of 'c' only matter as blockers.
+bool Board::isCheckAfter(const Move & m, Piece::Color c) const
+{
+  int from = m.from();
+  int to = m.to();
+  unsigned long long occupied = (getOccupied() & ~(1ULL << from)) | (1ULL << to);
+  unsigned long long captured = 1ULL << to;
+  unsigned long long king = m_pieces[Piece::KING] & m_color[c];
+
+  if(m.kind() == Move::ENPASSANT) {
+    captured = 1ULL << ((from & ~7) | (to & 7));
+    occupied ^= captured;
+  } else if(m.kind() == Move::CASTLING) {
+    int rookFrom = (to > from) ? from + 3 : from - 4;
+    int rookTo = (to > from) ? from + 1 : from - 1;
+    occupied ^= (1ULL << rookFrom) | (1ULL << rookTo);
+  }
 
-    int last;
-    
-    // Generate possible moves for pieces performing a few simple tests
-    // to make sure that they are valid
-    switch(p->type()) {
-      case Piece::PAWN:
-        if(c == Piece::WHITE) {
-          trialMoves.push_back(BoardMove(pos[i], pos[i].N().N(), p));
-          trialMoves.push_back(BoardMove(pos[i], pos[i].N(), p));
-          trialMoves.push_back(BoardMove(pos[i], pos[i].NE(), p));
-          trialMoves.push_back(BoardMove(pos[i], pos[i].NW(), p));
-        } else {
-            trialMoves.push_back(BoardMove(pos[i], pos[i].S().S(), p));
-          trialMoves.push_back(BoardMove(pos[i], pos[i].S(), p));
-          trialMoves.push_back(BoardMove(pos[i], pos[i].SE(), p));
-          trialMoves.push_back(BoardMove(pos[i], pos[i].SW(), p));
-        }
+  if(king & (1ULL << from)) {
+    king = 1ULL << to;
+  }
+  if(!king) {
+    return false;
+  }
 
-        // Needed outside the loop since size of trialMoves changes
-        last = trialMoves.size()-1;
-        for(int j=0; j < 3; j++) {
-          if(trialMoves[last-j].needPromotion()) {
-            BoardMove move = trialMoves[last-j];
-            trialMoves[last-j].setPromotion(Piece::QUEEN);
-            move.setPromotion(Piece::ROOK);
-            trialMoves.push_back(move);
-            move.setPromotion(Piece::BISHOP);
-            trialMoves.push_back(move);
-            move.setPromotion(Piece::KNIGHT);
-            trialMoves.push_back(move);
-          }
-        }
-        break;
-      case Piece::KNIGHT:
-        trialMoves.push_back(BoardMove(pos[i], pos[i].NE().N(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].NE().E(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].NW().N(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].NW().W(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].SE().S(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].SE().E(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].SW().S(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].SW().W(), p));
-        break;
-      case Piece::QUEEN:
-      case Piece::BISHOP:
-        for(bp = pos[i].NE(); !bp.outNE(); bp.moveNE()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        } 
-        for(bp = pos[i].NW(); !bp.outNW(); bp.moveNW()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        } 
+  return (attackersTo(BitBoard::lsb(king), c, occupied) & ~captured) != 0;
+}
 
-        for(bp = pos[i].SW(); !bp.outSW(); bp.moveSW()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        } 
+unsigned long long Board::attackersTo(int sq, Piece::Color c, unsigned long long occupied) const
+{
+  unsigned long long queens = m_pieces[Piece::QUEEN];
+  unsigned long long board = 0LL;
 
-        for(bp = pos[i].SE(); !bp.outSE(); bp.moveSE()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        }
-        if(p->type() == Piece::BISHOP)
-          break;
-      case Piece::ROOK:
-        for(bp = pos[i].N(); !bp.outN(); bp.moveN()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        } 
+  board |= pawnAttacks[c][sq] & m_pieces[Piece::PAWN];
+  board |= knightAttacks[sq] & m_pieces[Piece::KNIGHT];
+  board |= kingAttacks[sq] & m_pieces[Piece::KING];
+  board |= rookAttacks(sq, occupied) & (m_pieces[Piece::ROOK] | queens);
+  board |= bishopAttacks(sq, occupied) & (m_pieces[Piece::BISHOP] | queens);
 
-        for(bp = pos[i].W(); !bp.outW(); bp.moveW()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        } 
+  return board & m_color[Piece::opposite(c)];
+}
 
-        for(bp = pos[i].S(); !bp.outS(); bp.moveS()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        } 
+// Piece types from least to most valuable, kings last
+static const Piece::Type cheapestFirst[Piece::LAST_TYPE + 1] = {
+  Piece::PAWN, Piece::KNIGHT, Piece::BISHOP, Piece::ROOK, Piece::QUEEN, Piece::KING
+};
 
-        for(bp = pos[i].E(); !bp.outE(); bp.moveE()) {
-          trialMoves.push_back(BoardMove(pos[i], bp, p));
-          if(isOccupied(bp))
-            break;
-        }
-        break;
-      case Piece::KING:
-        trialMoves.push_back(BoardMove(pos[i], pos[i].N(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].S(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].E(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].W(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].NE(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].NW(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].SE(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].SW(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].E().E(), p));
-        trialMoves.push_back(BoardMove(pos[i], pos[i].W().W(), p));
-        break;
+// Works like a minimax over the list of captures on the square, see
+// the Chess Programming Wiki's "SEE - The Swap Algorithm". gain[d] is
+// what the side making capture d wins if the exchange stops after it.
+int Board::see(const Move & m) const
+{
+  int from = m.from();
+  int to = m.to();
+  int gain[32];
+  int depth = 0;
+
+  if(m.kind() == Move::CASTLING) {
+    return 0;
+  }
+
+  Piece::Color side = (m_color[Piece::WHITE] & (1ULL << from)) ? Piece::WHITE : Piece::BLACK;
+  Piece::Type attacker = typeAt(from);
+  unsigned long long occupied = getOccupied() ^ (1ULL << from);
+
+  Piece::Type victim = typeAt(to);
+  gain[0] = (victim == Piece::NOTYPE) ? 0 : m_piece_value[victim];
+  if(m.kind() == Move::ENPASSANT) {
+    gain[0] = m_piece_value[Piece::PAWN];
+    occupied ^= 1ULL << ((from & ~7) | (to & 7));
+  } else if(m.kind() == Move::PROMOTION) {
+    attacker = m.promotion();
+    gain[0] += m_piece_value[attacker] - m_piece_value[Piece::PAWN];
+  }
+
+  unsigned long long diagonal = m_pieces[Piece::BISHOP] | m_pieces[Piece::QUEEN];
+  unsigned long long straight = m_pieces[Piece::ROOK] | m_pieces[Piece::QUEEN];
+  unsigned long long attackers =
+    (pawnAttacks[Piece::WHITE][to] & m_pieces[Piece::PAWN] & m_color[Piece::BLACK]) |
+    (pawnAttacks[Piece::BLACK][to] & m_pieces[Piece::PAWN] & m_color[Piece::WHITE]) |
+    (knightAttacks[to] & m_pieces[Piece::KNIGHT]) |
+    (kingAttacks[to] & m_pieces[Piece::KING]) |
+    (bishopAttacks(to, occupied) & diagonal) |
+    (rookAttacks(to, occupied) & straight);
+  attackers &= occupied;
+
+  while(depth < 31) {
+    side = Piece::opposite(side);
+    unsigned long long own = attackers & m_color[side];
+    if(!own) {
+      break;
+    }
+
+    int i = 0;
+    while(!(own & m_pieces[cheapestFirst[i]])) {
+      i++;
+    }
+
+    // A king may not capture onto a defended square
+    if(cheapestFirst[i] == Piece::KING && (attackers & m_color[Piece::opposite(side)])) {
+      break;
+    }
+
+    // The piece last moved to the square is taken
+    depth++;
+    gain[depth] = m_piece_value[attacker] - gain[depth - 1];
+
+    attacker = cheapestFirst[i];
+    occupied ^= 1ULL << BitBoard::lsb(own & m_pieces[attacker]);
+
+    // Uncover the sliders behind the piece that just captured
+    if(attacker == Piece::PAWN || attacker == Piece::BISHOP || attacker == Piece::QUEEN) {
+      attackers |= bishopAttacks(to, occupied) & diagonal;
+    }
+    if(attacker == Piece::ROOK || attacker == Piece::QUEEN) {
+      attackers |= rookAttacks(to, occupied) & straight;
+    }
+    attackers &= occupied;
+  }
+
+  // Each side only makes its capture if that is better than stopping
+  for(; depth > 0; depth--) {
+    if(-gain[depth] < gain[depth - 1]) {
+      gain[depth - 1] = -gain[depth];
+    }
+  }
+
+  return gain[0];
+}
+
+unsigned long long Board::hangingPieces(Piece::Color c) const
+{
+  unsigned long long occupied = getOccupied();
+  unsigned long long targets = m_color[c] & ~m_pieces[Piece::KING];
+  unsigned long long hanging = 0LL;
+
+  for(int sq : BitBoard(targets)) {
+    unsigned long long attackers = attackersTo(sq, c, occupied);
+    if(!attackers) {
+      continue;
+    }
+
+    // Starting the exchange with the cheapest attacker is good enough
+    // for a hint
+    int i = 0;
+    while(!(attackers & m_pieces[cheapestFirst[i]])) {
+      i++;
+    }
+    if(see(Move(BitBoard::lsb(attackers & m_pieces[cheapestFirst[i]]), sq)) > 0) {
+      hanging |= 1ULL << sq;
+    }
+  }
+
+  return hanging;
+}
+
+// Moves are generated straight from the attack tables. Instead of trying
+// every move on the board, pinned pieces are kept on the line to their
+// king and, in check, the other pieces may only capture the checker or
+// block it. Only king moves and en passant captures are tested against
+// the resulting position.
+void Board::generateMoves(Piece::Color c, MoveList & moves, bool findOne) const
+{
+  generate(c, moves, findOne, false);
+}
+
+void Board::generateCaptures(Piece::Color c, MoveList & moves) const
+{
+  generate(c, moves, false, true);
+}
+
+void Board::generate(Piece::Color c, MoveList & moves, bool findOne, bool capturesOnly) const
+{
+  moves.clear();
+
+  Piece::Color enemy = Piece::opposite(c);
+  unsigned long long own = m_color[c];
+  unsigned long long occupied = getOccupied();
+  unsigned long long queens = m_pieces[Piece::QUEEN] & m_color[enemy];
+  int king = m_king_pos[c].hash();
+
+  // Squares the pieces other than pawns may move to
+  unsigned long long allowed = capturesOnly ? m_color[enemy] : ~own;
+
+  // King moves, the king itself must not block attacks on its new square
+  unsigned long long targets = kingAttacks[king] & allowed;
+  unsigned long long kingless = occupied ^ (1ULL << king);
+  for(int to : BitBoard(targets)) {
+    if(!attackersTo(to, c, kingless)) {
+      moves.push(Move(king, to));
+    }
+  }
+  if(findOne && !moves.empty()) {
+    return;
+  }
+
+  unsigned long long checkers = attackersTo(king, c, occupied);
+
+  // In double check only the king can move
+  if(checkers & (checkers - 1)) {
+    return;
+  }
+
+  // Squares a piece must move to when not in check, or to capture the
+  // checker or step in its way when in check
+  unsigned long long evasions = ~own;
+  if(checkers) {
+    evasions = checkers | m_between[king][BitBoard::lsb(checkers)];
+  }
+  unsigned long long promotions = maskRank(BoardPosition('a', c == Piece::WHITE ? 8 : 1));
+
+  // An own piece alone between the king and an enemy slider is pinned
+  // and may only move along that line
+  unsigned long long pinned = 0LL;
+  unsigned long long pinLine[BOARDSIZE*BOARDSIZE];
+  unsigned long long snipers =
+    (rookAttacks(king, 0LL) & ((m_pieces[Piece::ROOK] & m_color[enemy]) | queens)) |
+    (bishopAttacks(king, 0LL) & ((m_pieces[Piece::BISHOP] & m_color[enemy]) | queens));
+  for(int sniper : BitBoard(snipers)) {
+    unsigned long long blockers = m_between[king][sniper] & occupied;
+    if(blockers && !(blockers & (blockers - 1)) && (blockers & own)) {
+      pinned |= blockers;
+      pinLine[BitBoard::lsb(blockers)] = m_between[king][sniper] | (1ULL << sniper);
+    }
+  }
+
+  // Pawns
+  unsigned long long pawns = m_pieces[Piece::PAWN] & own;
+  unsigned long long enpassant = m_enpassant_flags &
+    maskRank(BoardPosition('a', c == Piece::WHITE ? 6 : 3));
+  int forward = (c == Piece::WHITE) ? BOARDSIZE : -BOARDSIZE;
+  int startRank = (c == Piece::WHITE) ? 1 : 6;
+  int lastRank = (c == Piece::WHITE) ? 7 : 0;
+
+  for(int from : BitBoard(pawns)) {
+    unsigned long long push = 1ULL << (from + forward);
+
+    targets = 0LL;
+    if(!(push & occupied)) {
+      targets |= push;
+      if(from / BOARDSIZE == startRank && !((1ULL << (from + 2*forward)) & occupied)) {
+        targets |= 1ULL << (from + 2*forward);
+      }
+    }
+    targets |= pawnAttacks[c][from] & m_color[enemy];
+    targets &= evasions;
+    if(capturesOnly) {
+      targets &= m_color[enemy] | promotions;
+    }
+    if(pinned & (1ULL << from)) {
+      targets &= pinLine[from];
     }
 
-    // For the moves that passed the basic test
-    for(int j=0; j < trialMoves.size(); j++) {
-      if(isMoveLegal(trialMoves[j])) {
-        goodMoves.push_back(trialMoves[j]);
+    for(int to : BitBoard(targets)) {
+      if(to / BOARDSIZE == lastRank) {
+        moves.push(Move(from, to, Move::PROMOTION, Piece::QUEEN));
+        moves.push(Move(from, to, Move::PROMOTION, Piece::ROOK));
+        moves.push(Move(from, to, Move::PROMOTION, Piece::BISHOP));
+        moves.push(Move(from, to, Move::PROMOTION, Piece::KNIGHT));
+      } else {
+        moves.push(Move(from, to));
       }
-      if(goodMoves.size() && findOne) {
-        return goodMoves;
+    }
+
+    // En passant removes two pieces from a line, which the pins above
+    // do not cover, so the resulting occupancy is checked instead
+    if(pawnAttacks[c][from] & enpassant) {
+      Move move(from, BitBoard::lsb(enpassant), Move::ENPASSANT);
+
+      if(!isCheckAfter(move, c)) {
+        moves.push(move);
       }
     }
-    trialMoves.clear();
   }
-  
-  return goodMoves;
+  if(findOne && !moves.empty()) {
+    return;
+  }
+
+  // Knights, a pinned knight can never move
+  unsigned long long knights = m_pieces[Piece::KNIGHT] & own & ~pinned;
+  for(int from : BitBoard(knights)) {
+    addMoves(moves, from, knightAttacks[from] & evasions & allowed);
+  }
+
+  // Sliding pieces
+  for(int t = Piece::ROOK; t <= Piece::QUEEN; t++) {
+    if(t == Piece::KNIGHT) {
+      continue;
+    }
+
+    unsigned long long sliders = m_pieces[t] & own;
+    for(int from : BitBoard(sliders)) {
+      if(t == Piece::ROOK) {
+        targets = rookAttacks(from, occupied);
+      } else if(t == Piece::BISHOP) {
+        targets = bishopAttacks(from, occupied);
+      } else {
+        targets = queenAttacks(from, occupied);
+      }
+      targets &= evasions & allowed;
+      if(pinned & (1ULL << from)) {
+        targets &= pinLine[from];
+      }
+
+      addMoves(moves, from, targets);
+    }
+  }
+  if(findOne && !moves.empty()) {
+    return;
+  }
+
+  // Castling, the king may not leave, pass or land on an attacked square
+  if(!capturesOnly && !checkers && (m_castling_flags & (1ULL << king))) {
+    unsigned long long rooks = m_pieces[Piece::ROOK] & own & m_castling_flags;
+
+    if((rooks & (1ULL << (king + 3))) && !(occupied & (3ULL << (king + 1))) &&
+       !attackersTo(king + 1, c, occupied) && !attackersTo(king + 2, c, occupied)) {
+      moves.push(Move(king, king + 2, Move::CASTLING));
+    }
+    if((rooks & (1ULL << (king - 4))) && !(occupied & (7ULL << (king - 3))) &&
+       !attackersTo(king - 1, c, occupied) && !attackersTo(king - 2, c, occupied)) {
+      moves.push(Move(king, king - 2, Move::CASTLING));
+    }
+  }
+}
+
+vector<BoardMove> Board::possibleMoves(Piece::Color c, bool findOne) const
+{
+  MoveList list;
+  vector<BoardMove> moves;
+
+  generateMoves(c, list, findOne);
+
+  moves.reserve(list.size());
+  for(int i = 0; i < list.size(); i++) {
+    moves.push_back(toBoardMove(list[i]));
+  }
+
+  return moves;
 }
 
-int Board::getRankState(const BoardPosition & bp) const
+BoardMove Board::toBoardMove(const Move & m) const
 {
-  return ((m_color[Piece::WHITE] | m_color[Piece::BLACK]) >> bp.rank0()*BOARDSIZE) & 0xff;
+  return BoardMove(BoardPosition(m.from()), BoardPosition(m.to()),
+                   getPiece(BoardPosition(m.from())), m.promotion());
 }
 
-int Board::getFileState(const BoardPosition & bp) const
+Move Board::toMove(const BoardMove & bm) const
 {
-        long long state = 0LL;
-        int ret = 0;
-        unsigned char rank = bp.rank0();
-        unsigned char file = bp.file0();
+  int from = bm.origin().hash();
+  int to = bm.dest().hash();
+  Piece::Type type = bm.getPiece()->type();
 
-        state = (m_color[Piece::WHITE] | m_color[Piece::BLACK]) & maskFile(bp);
-        char shift = file;
-        for(int i = 0; i < 7; i++) {
-                ret |= (state >> shift);
-                shift += BOARDSIZE - 1;
-        }
+  if(type == Piece::PAWN && ((1ULL << to) & 0xff000000000000ffULL)) {
+    Piece::Type promote = bm.getPromotion();
+    return Move(from, to, Move::PROMOTION, (promote == Piece::NOTYPE) ? Piece::QUEEN : promote);
+  }
+  if(type == Piece::PAWN && ((1ULL << to) & m_enpassant_flags) && bm.fileDiff()) {
+    return Move(from, to, Move::ENPASSANT);
+  }
+  if(type == Piece::KING && bm.fileDiff() == 2) {
+    return Move(from, to, Move::CASTLING);
+  }
 
-        return ret & 0xFF;
+  return Move(from, to);
 }
 
-int Board::getSEDiagState(const BoardPosition & bp) const
+
+void Board::setCastling(bool wk, bool wq, bool bk, bool bq)
 {
-  // Change this to use bit shifting in the future so it's faster
-  int state = 0, f = bp.file0(), r = bp.rank0();
-  BoardPosition tmp;
+  m_hash ^= castlingKey(m_castling_flags);
+  m_castling_flags = 0LL;
 
-  if(f+r < BOARDSIZE)
-    tmp = BoardPosition(0, f+r);
-  else
-    tmp = BoardPosition(f+r-7, 7);
+  if(wk || wq) m_castling_flags |= getMask(BoardPosition('e', 1));
+  if(wk)       m_castling_flags |= getMask(BoardPosition('h', 1));
+  if(wq)       m_castling_flags |= getMask(BoardPosition('a', 1));
+  if(bk || bq) m_castling_flags |= getMask(BoardPosition('e', 8));
+  if(bk)       m_castling_flags |= getMask(BoardPosition('h', 8));
+  if(bq)       m_castling_flags |= getMask(BoardPosition('a', 8));
 
-  for(int i = 0; !tmp.outSE(); tmp.moveSE(), i++)
-    if(getMask(tmp) & (m_color[Piece::WHITE] | m_color[Piece::BLACK]))
-      state += pow2[i];
+  m_hash ^= castlingKey(m_castling_flags);
+}
 
-  return state;
+void Board::setEnPassant(const BoardPosition & bp)
+{
+  m_hash ^= enpassantKey(m_enpassant_flags);
+  m_enpassant_flags = getMask(bp);
+  m_hash ^= enpassantKey(m_enpassant_flags);
 }
 
-int Board::getNEDiagState(const BoardPosition & bp) const
+void Board::setSideToMove(Piece::Color c)
 {
-  // Change this to use bit shifting in the future so it's faster
-  int state = 0, f = bp.file0(), r = bp.rank0();
-  BoardPosition tmp;
+  if(c != m_side_to_move) {
+    m_side_to_move = c;
+    m_hash ^= m_zobrist_side;
+  }
+}
 
-  if(f > r)
-    tmp = BoardPosition(f-r, 0);
-  else
-    tmp = BoardPosition(0, r-f);
+unsigned long long Board::castlingKey(unsigned long long flags)
+{
+  unsigned long long key = 0LL;
+
+  // A castling right needs both the king and the rook flag, a rook flag
+  // left over after the king moved must not change the key
+  static const int corners[4] = { 7, 0, 63, 56 };
+  for(int i = 0; i < 4; i++) {
+    unsigned long long king = 1ULL << (i < 2 ? 4 : 60);
+    if((flags & king) && (flags & (1ULL << corners[i]))) {
+      key ^= m_zobrist_castling[corners[i]];
+    }
+  }
 
-  for(int i = 0; !tmp.outNE(); tmp.moveNE(), i++)
-    if(getMask(tmp) & (m_color[Piece::WHITE] | m_color[Piece::BLACK]))
-      state += pow2[i];
-  
-  return state;
+  return key;
 }
 
 // Given a valid and legal move, updates the board to reflect the move.
 // This function should only be called from ChessGame::tryMove.
 void Board::update(const BoardMove & bm)
 {
-  Piece::Color color = getPiece(bm.origin())->color();
-  Piece::Type type = getPiece(bm.origin())->type();
-  
-  if(type == Piece::PAWN) {
-    if(isEnPassantSet(bm.dest()) && color == Piece::WHITE) {
-      removePiece(bm.dest().S());
-    } else if(isEnPassantSet(bm.dest()) && color == Piece::BLACK) {
-      removePiece(bm.dest().N());
-    } else if(bm.dest().rank() == 8 || bm.dest().rank() == 1) {
-      type = bm.getPromotion();
-    }
-  } else if(type == Piece::KING && bm.signedFileDiff() == -2) {
-    // Castling to the left
-    BoardPosition corner = (color == Piece::WHITE) ?
-      BoardPosition('a',1) : BoardPosition('a',8);
-
-    setPiece(getPiece(corner), bm.origin().W());
-    removePiece(corner);
-
-    m_castling_flags &= ~getMask(corner);
-  } else if(type == Piece::KING && bm.signedFileDiff() == 2) {
-    // Castling to the right
-    BoardPosition corner =
-      (
-        (color == Piece::WHITE)
-        ? BoardPosition('h',1)
-        : BoardPosition('h',8)
-      );
+  UndoInfo undo;
+  makeMove(toMove(bm), undo);
+}
 
-    setPiece(
-      getPiece(corner),
-      bm.origin().E()
-    );
-    removePiece(corner);
+void Board::makeMove(const Move & m, UndoInfo & undo)
+{
+  int from = m.from();
+  int to = m.to();
+  unsigned long long fromMask = 1ULL << from;
+  unsigned long long toMask = 1ULL << to;
+
+  Piece::Color color = (m_color[Piece::WHITE] & fromMask) ? Piece::WHITE : Piece::BLACK;
+  Piece::Color other = Piece::opposite(color);
+  Piece::Type type = typeAt(from);
+
+  undo.enpassant_flags = m_enpassant_flags;
+  undo.castling_flags = m_castling_flags;
+  undo.hash = m_hash;
+  undo.moved = type;
+  undo.captured = Piece::NOTYPE;
+  undo.captured_square = to;
+  undo.psq_middlegame = m_psq_middlegame;
+  undo.psq_endgame = m_psq_endgame;
+  undo.material = m_material;
+  undo.pawn_hash = m_pawn_hash;
+
+  if(m_color[other] & toMask) {
+    undo.captured = typeAt(to);
+  } else if(m.kind() == Move::ENPASSANT) {
+    // The captured pawn is behind the destination
+    undo.captured = Piece::PAWN;
+    undo.captured_square = (color == Piece::WHITE) ? to - BOARDSIZE : to + BOARDSIZE;
+  }
 
-    m_castling_flags &= ~getMask(corner);
+  if(undo.captured != Piece::NOTYPE) {
+    unsigned long long capturedMask = 1ULL << undo.captured_square;
+    m_pieces[undo.captured] ^= capturedMask;
+    m_color[other] ^= capturedMask;
+    m_mailbox[undo.captured_square] = EMPTY_SQUARE;
+    m_hash ^= m_zobrist_pieces[other][undo.captured][undo.captured_square];
+    updatePsq(other, undo.captured, undo.captured_square, -1);
+    m_piece_count[other][undo.captured]--;
+    m_total_pieces[other]--;
   }
 
-  setPiece(color, type, bm.dest());
-  removePiece(bm.origin());
-  setSpecialPieceFlags(bm);
-}
+  m_color[color] ^= fromMask | toMask;
+  m_mailbox[from] = EMPTY_SQUARE;
+
+  if(m.kind() == Move::PROMOTION) {
+    Piece::Type promote = m.promotion();
+    m_pieces[Piece::PAWN] ^= fromMask;
+    m_pieces[promote] ^= toMask;
+    m_mailbox[to] = pieceCode(color, promote);
+    m_hash ^= m_zobrist_pieces[color][Piece::PAWN][from] ^ m_zobrist_pieces[color][promote][to];
+    updatePsq(color, Piece::PAWN, from, -1);
+    updatePsq(color, promote, to, 1);
+    m_piece_count[color][Piece::PAWN]--;
+    m_piece_count[color][promote]++;
+  } else {
+    m_pieces[type] ^= fromMask | toMask;
+    m_mailbox[to] = pieceCode(color, type);
+    m_hash ^= m_zobrist_pieces[color][type][from] ^ m_zobrist_pieces[color][type][to];
+    updatePsq(color, type, from, -1);
+    updatePsq(color, type, to, 1);
+  }
 
-void Board::setSpecialPieceFlags(const BoardMove & bm)
-{
-  Piece::Color color = bm.getPiece()->color();
-  Piece::Type  type  = bm.getPiece()->type();
+  if(type == Piece::KING) {
+    m_king_pos[color] = BoardPosition(to);
+
+    if(m.kind() == Move::CASTLING) {
+      // The rook jumps over the king
+      int rookFrom = (to > from) ? from + 3 : from - 4;
+      int rookTo = (to > from) ? from + 1 : from - 1;
+      unsigned long long rookMask = (1ULL << rookFrom) | (1ULL << rookTo);
+
+      m_pieces[Piece::ROOK] ^= rookMask;
+      m_color[color] ^= rookMask;
+      m_mailbox[rookTo] = m_mailbox[rookFrom];
+      m_mailbox[rookFrom] = EMPTY_SQUARE;
+      m_hash ^= m_zobrist_pieces[color][Piece::ROOK][rookFrom] ^
+                m_zobrist_pieces[color][Piece::ROOK][rookTo];
+      updatePsq(color, Piece::ROOK, rookFrom, -1);
+      updatePsq(color, Piece::ROOK, rookTo, 1);
+      m_castling_flags &= ~(1ULL << rookFrom);
+    }
+  }
 
-  // Reset En Passant flag from previous turn
-  if (color == Piece::BLACK) {
-    m_enpassant_flags &= ~maskRank(BoardPosition('a', 3));
-  } else {
-    m_enpassant_flags &= ~maskRank(BoardPosition('a', 6));
+  // Only the double push of this move can be captured en passant
+  m_enpassant_flags = 0LL;
+  if(type == Piece::PAWN && (to - from == 2*BOARDSIZE || from - to == 2*BOARDSIZE)) {
+    m_enpassant_flags = 1ULL << ((from + to) / 2);
   }
 
-  // Remove castling flags if any piece attacks a corner
-  m_castling_flags &= ~getMask(bm.dest());
+  // Moving a king or rook, or capturing on a corner, loses castling
+  m_castling_flags &= ~(fromMask | toMask);
 
-  // Queens, knights and bishops don't have any special moves. If the 
-  // piece is a pawn but doesn't move 2 ranks, nothing to be done.
-  if (type == Piece::QUEEN || type == Piece::KNIGHT || type == Piece::BISHOP) {
-    return;
+  m_hash ^= enpassantKey(undo.enpassant_flags) ^ enpassantKey(m_enpassant_flags);
+  m_hash ^= castlingKey(undo.castling_flags) ^ castlingKey(m_castling_flags);
+  m_hash ^= m_zobrist_side;
+  m_side_to_move = other;
+}
+
+void Board::unmakeMove(const Move & m, const UndoInfo & undo)
+{
+  int from = m.from();
+  int to = m.to();
+  unsigned long long fromMask = 1ULL << from;
+  unsigned long long toMask = 1ULL << to;
+
+  Piece::Color color = (m_color[Piece::WHITE] & toMask) ? Piece::WHITE : Piece::BLACK;
+  Piece::Color other = Piece::opposite(color);
+
+  if(undo.moved == Piece::KING) {
+    m_king_pos[color] = BoardPosition(from);
+
+    if(m.kind() == Move::CASTLING) {
+      int rookFrom = (to > from) ? from + 3 : from - 4;
+      int rookTo = (to > from) ? from + 1 : from - 1;
+      unsigned long long rookMask = (1ULL << rookFrom) | (1ULL << rookTo);
+
+      m_pieces[Piece::ROOK] ^= rookMask;
+      m_color[color] ^= rookMask;
+      m_mailbox[rookFrom] = m_mailbox[rookTo];
+      m_mailbox[rookTo] = EMPTY_SQUARE;
+    }
   }
-  if (type == Piece::PAWN && bm.rankDiff() != 2) {
-    return;
+
+  if(m.kind() == Move::PROMOTION) {
+    Piece::Type promote = m.promotion();
+    m_pieces[promote] ^= toMask;
+    m_pieces[Piece::PAWN] ^= fromMask;
+    m_piece_count[color][promote]--;
+    m_piece_count[color][Piece::PAWN]++;
+  } else {
+    m_pieces[undo.moved] ^= fromMask | toMask;
   }
 
-  // Handle En-Passant
-  if (type == Piece::PAWN && color == Piece::WHITE) {
-    // Set the en-passant bit for the pawn that moved.  
-    m_enpassant_flags |= getMask(bm.origin().N());
-    return;
-  } else if (type == Piece::PAWN && color == Piece::BLACK) {
-    // Pretty much same as the white case
-    m_enpassant_flags |= getMask(bm.origin().S());
-    return;
-  } 
-  // Remove castling flag because a king or rook was moved. Even
-  // though most positions don't have castling flags, this seems
-  // like the best way to do it. If the move being made is actually
-  // castling, the update function explicitly removes the rook's
-  // flag while this here will remove the king's.
-  else {
-    m_castling_flags &= ~getMask(bm.origin());
-    return;
+  m_color[color] ^= fromMask | toMask;
+  m_mailbox[from] = pieceCode(color, undo.moved);
+  m_mailbox[to] = EMPTY_SQUARE;
+
+  if(undo.captured != Piece::NOTYPE) {
+    unsigned long long capturedMask = 1ULL << undo.captured_square;
+    m_pieces[undo.captured] ^= capturedMask;
+    m_color[other] ^= capturedMask;
+    m_mailbox[undo.captured_square] = pieceCode(other, undo.captured);
+    m_piece_count[other][undo.captured]++;
+    m_total_pieces[other]++;
   }
+
+  m_enpassant_flags = undo.enpassant_flags;
+  m_castling_flags = undo.castling_flags;
+  m_hash = undo.hash;
+  m_side_to_move = color;
+  m_psq_middlegame = undo.psq_middlegame;
+  m_psq_endgame = undo.psq_endgame;
+  m_material = undo.material;
+  m_pawn_hash = undo.pawn_hash;
 }
 
-SerialBoard Board::serialize() const
+void Board::makeNullMove(UndoInfo & undo)
 {
-  SerialBoard sb;
-  for(int i=0; i < Piece::LAST_TYPE; i++) {
-    sb.pieces[i] = m_pieces[i];
-  }
-  sb.color[0] = m_color[0];
-  sb.color[1] = m_color[1];
+  undo.enpassant_flags = m_enpassant_flags;
+  undo.castling_flags = m_castling_flags;
+  undo.hash = m_hash;
+  undo.moved = Piece::NOTYPE;
+  undo.captured = Piece::NOTYPE;
 
-  sb.white_enpassant = (m_enpassant_flags >> 2*BOARDSIZE) & 0xFF;
-  sb.black_enpassant = (m_enpassant_flags >> 5*BOARDSIZE) & 0xFF;
-  sb.wk_castling = (m_castling_flags>>0) & (m_castling_flags>>3) & 1;
-  sb.wq_castling = (m_castling_flags>>7) & (m_castling_flags>>3) & 1;
-  sb.bk_castling = (m_castling_flags>>56) & (m_castling_flags>>59) & 1;
-  sb.bq_castling = (m_castling_flags>>63) & (m_castling_flags>>59) & 1;
-  return sb;
+  m_hash ^= enpassantKey(m_enpassant_flags) ^ m_zobrist_side;
+  m_enpassant_flags = 0LL;
+  m_side_to_move = Piece::opposite(m_side_to_move);
+}
+
+void Board::unmakeNullMove(const UndoInfo & undo)
+{
+  m_enpassant_flags = undo.enpassant_flags;
+  m_hash = undo.hash;
+  m_side_to_move = Piece::opposite(m_side_to_move);
 }
 
 // Unsets all of the pieces bits, and the occupied bit for 'bp'
 inline void Board::unsetAllBits(const BoardPosition & bp)
 {
   unsigned long long mask = ~getMask(bp);
+  unsigned char code = m_mailbox[bp.hash()];
+
+  if(code != EMPTY_SQUARE) {
+    m_hash ^= m_zobrist_pieces[code >> 3][code & 7][bp.hash()];
+    updatePsq(Piece::Color(code >> 3), Piece::Type(code & 7), bp.hash(), -1);
+  }
 
   // Unset all the piece bits
   for(int i = 0; i <= Piece::LAST_TYPE; i++)
@@ -726,6 +1081,8 @@ inline void Board::unsetAllBits(const BoardPosition & bp)
 
   for (int i = 0; i <= Piece::LAST_COLOR; i++)
     m_color[i] &= mask;
+
+  m_mailbox[bp.hash()] = EMPTY_SQUARE;
 }
 
 std::ostream& operator<< (std::ostream& os, const Board& b)
@@ -741,13 +1098,164 @@ std::ostream& operator<< (std::ostream& os, const Board& b)
   return os;
 }
 
+unsigned long long Board::rookMagicAttacks(int sq, unsigned long long occupied)
+{
+  const Magic & m = m_rook_magics[sq];
+  return m.attacks[magicIndex(m, occupied)];
+}
+
+unsigned long long Board::bishopMagicAttacks(int sq, unsigned long long occupied)
+{
+  const Magic & m = m_bishop_magics[sq];
+  return m.attacks[magicIndex(m, occupied)];
+}
+
+#ifdef NICECHESS_PEXT
+// Parallel bit extract, only to be called if the CPU has BMI2. Callers
+// built for BMI2 too get it inlined.
+__attribute__((target("bmi2")))
+static inline unsigned long long pext(unsigned long long value, unsigned long long mask)
+{
+  return __builtin_ia32_pext_di(value, mask);
+}
+
+__attribute__((target("bmi2")))
+unsigned long long Board::rookPextAttacks(int sq, unsigned long long occupied)
+{
+  const Magic & m = m_rook_magics[sq];
+  return m.attacks[pext(occupied, m.mask)];
+}
+
+__attribute__((target("bmi2")))
+unsigned long long Board::bishopPextAttacks(int sq, unsigned long long occupied)
+{
+  const Magic & m = m_bishop_magics[sq];
+  return m.attacks[pext(occupied, m.mask)];
+}
+#endif
+
+// Returns the squares a slider on 'sq' reaches along its four directions,
+// stopping on the first occupied square of each.
+static unsigned long long slidingAttacks(int sq, unsigned long long occupied, bool rook)
+{
+  static const int rookDirections[4][2] = { {0, 1}, {1, 0}, {0, -1}, {-1, 0} };
+  static const int bishopDirections[4][2] = { {1, 1}, {1, -1}, {-1, -1}, {-1, 1} };
+  const int (*directions)[2] = rook ? rookDirections : bishopDirections;
+  unsigned long long attacks = 0LL;
+
+  for(int d = 0; d < 4; d++) {
+    BoardPosition bp(sq);
+
+    for(bp = BoardPosition(bp.x() + directions[d][0], bp.y() + directions[d][1]);
+        bp.isValid();
+        bp = BoardPosition(bp.x() + directions[d][0], bp.y() + directions[d][1])) {
+      attacks |= getMask(bp);
+      if(occupied & getMask(bp))
+        break;
+    }
+  }
+
+  return attacks;
+}
+
+// Small xorshift64* generator, seeded the same way every run so that the
+// magic numbers and hash keys are always the same.
+static unsigned long long random64(unsigned long long & seed)
+{
+  seed ^= seed >> 12;
+  seed ^= seed << 25;
+  seed ^= seed >> 27;
+  return seed * 2685821657736338717ULL;
+}
+
+// Magics with few bits set are found much faster
+static unsigned long long randomMagic(unsigned long long & seed)
+{
+  return random64(seed) & random64(seed) & random64(seed);
+}
+
+// Fills the attack table of every square. Without PEXT a magic number
+// is searched for each square that maps every blocker subset to an
+// index without destructive collisions.
+void Board::initMagics(Magic magics[64], unsigned long long * table, bool rook)
+{
+  static unsigned long long occupancy[4096];
+  static unsigned long long reference[4096];
+  static int epoch[4096];
+  // Seeds per rank known to find magics quickly
+  static const unsigned long long seeds[BOARDSIZE] =
+    { 728, 10316, 55710, 4765, 15495, 21488, 61279, 20179 };
+  unsigned long long seed = 0LL;
+  unsigned long long * attacks = table;
+  int attempt = 0;
+
+  // Epochs left over from the other slider would reject every attempt
+  // until 'attempt' caught up with them
+  memset(epoch, 0, sizeof(epoch));
+
+  for(int sq = 0; sq < BOARDSIZE*BOARDSIZE; sq++) {
+    Magic & m = magics[sq];
+    BoardPosition bp(sq);
+
+    // Edge squares never block, a slider reaches them anyway
+    unsigned long long edges =
+      ((0xffULL | 0xff00000000000000ULL) & ~maskRank(bp)) |
+      ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~maskFile(bp));
+
+    m.mask = slidingAttacks(sq, 0LL, rook) & ~edges;
+    m.shift = 64 - BitBoard::popcount(m.mask);
+    m.attacks = attacks;
+    seed = seeds[sq / BOARDSIZE];
+
+    // Enumerate all subsets of the mask (Carry-Rippler)
+    int size = 0;
+    unsigned long long b = 0LL;
+    do {
+      occupancy[size] = b;
+      reference[size] = slidingAttacks(sq, b, rook);
+      size++;
+      b = (b - m.mask) & m.mask;
+    } while(b);
+
+#ifdef NICECHESS_PEXT
+    if(m_use_pext) {
+      m.magic = 0LL;
+      for(int i = 0; i < size; i++) {
+        m.attacks[pext(occupancy[i], m.mask)] = reference[i];
+      }
+      attacks += size;
+      continue;
+    }
+#endif
+
+    bool found = false;
+    while(!found) {
+      do {
+        m.magic = randomMagic(seed);
+      } while(BitBoard::popcount((m.magic * m.mask) >> 56) < 6);
+
+      attempt++;
+      found = true;
+
+      for(int i = 0; i < size; i++) {
+        unsigned int index = magicIndex(m, occupancy[i]);
+
+        if(epoch[index] < attempt) {
+          epoch[index] = attempt;
+          m.attacks[index] = reference[i];
+        } else if(m.attacks[index] != reference[i]) {
+          found = false;
+          break;
+        }
+      }
+    }
+
+    attacks += size;
+  }
+}
+
 void Board::init()
 {
-  // Power of 2 array for computing current rank, file, and diag status
-  pow2[0] = 1;
-  for(int i = 1; i < BOARDSIZE; i++)
-    pow2[i] = 2*pow2[i-1];
-  
   // Initialize attack masks for non-sliding pieces
   for(int i = 0; i < BOARDSIZE*BOARDSIZE; i++) {
 
@@ -784,96 +1292,63 @@ void Board::init()
     kingAttacks[i] = king.getBoard();
   }
 
-  // Initialize all the masks for the sliding pieces (queens, rooks, bishops)
-  unsigned long long state;
-  for(int rank = 0; rank < BOARDSIZE; rank++) {
-    for(int file = 0; file < BOARDSIZE; file++) {
-      for(state = 0LL; state < 256LL; state++) {
-        
-        // Initialize the rank attack masks for sliding pieces
-        rankAttacks[rank*BOARDSIZE + file][state] = 0LL;
-        BoardPosition bp(file, rank);
-        bool occupied = false;
-
-        // Search to the east
-        for(bp.moveE(); !bp.outE() && !occupied; bp.moveE()) {
-          rankAttacks[rank*BOARDSIZE + file][state] |= getMask(bp);
-          occupied = getMask(bp) & (state << rank*BOARDSIZE);
-        }
-
-        bp = BoardPosition(file, rank);
-        occupied = false;
-
-        // Search to the west
-        for(bp.moveW(); !bp.outW() && !occupied; bp.moveW()) {
-          rankAttacks[rank*BOARDSIZE + file][state] |= getMask(bp);
-          occupied = getMask(bp) & (state << rank*BOARDSIZE);
-        }
-
-        // Initialize the file attack masks for sliding pieces
-        fileAttacks[rank*BOARDSIZE + file][state] = 0LL;
-        bp = BoardPosition(file, rank);
-        occupied = false;
-
-        // Search to the north
-        for(bp.moveN(); !bp.outN() && !occupied; bp.moveN()) {
-          fileAttacks[rank*BOARDSIZE + file][state] |= getMask(bp);
-          occupied = 1LL & (state >> bp.rank0());
-        }
-
-        bp = BoardPosition(file, rank);
-        occupied = false;
-
-        // Search to the south
-        for(bp.moveS(); !bp.outS() && !occupied; bp.moveS()) {
-          fileAttacks[rank*BOARDSIZE + file][state] |= getMask(bp);
-          occupied = 1LL & (state >> bp.rank0());
-        }
-                
-        // Initialize the southeast diagonal attack masks
-        diagAttacksSE[rank*BOARDSIZE + file][state] = 0LL;
-        bp = BoardPosition(file, rank);
-        occupied = false;
-        int shift;
-
-        // Search to the southeast
-        for(bp.moveSE(); !bp.outSE() && ! occupied; bp.moveSE()) {
-          diagAttacksSE[rank*BOARDSIZE + file][state] |= getMask(bp);
-          shift = (rank+file < BOARDSIZE) ? bp.file0() : 7-bp.rank0();
-          occupied = (state >> shift) & 1LL;
-        }
-
-        bp = BoardPosition(file, rank);
-        occupied = false;
-        
-        // Search to the northwest
-        for(bp.moveNW(); !bp.outNW() && ! occupied; bp.moveNW()) {
-          diagAttacksSE[rank*BOARDSIZE + file][state] |= getMask(bp);
-          shift = (rank+file < BOARDSIZE) ? bp.file0() : 7-bp.rank0();
-          occupied = (state >> shift) & 1LL;
-        }
-
-        // Initialize the northeast diagonal attack masks
-        diagAttacksNE[rank*BOARDSIZE + file][state] = 0LL;
-        bp = BoardPosition(file, rank);
-        occupied = false;
-
-        // Search to the southwest
-        for(bp.moveSW(); !bp.outSW() && ! occupied; bp.moveSW()) {
-          diagAttacksNE[rank*BOARDSIZE + file][state] |= getMask(bp);
-          shift = (rank < file) ? bp.rank0() : bp.rank0() - (rank-file);
-          occupied = (state >> shift) & 1LL;
-        }
+  // Initialize the attack tables for the sliding pieces (queens, rooks, bishops)
+#ifdef NICECHESS_PEXT
+  __builtin_cpu_init();
+  m_use_pext = __builtin_cpu_supports("bmi2");
+#endif
+  initMagics(m_rook_magics, m_rook_table, true);
+  initMagics(m_bishop_magics, m_bishop_table, false);
+#ifdef NICECHESS_PEXT
+  if(m_use_pext) {
+    m_rook_attacks = rookPextAttacks;
+    m_bishop_attacks = bishopPextAttacks;
+  }
+#endif
+
+  // Zobrist keys, castling keys are only used on the four corners, one
+  // per castling right
+  unsigned long long seed = 1070372ULL;
+  for(int c = 0; c <= Piece::LAST_COLOR; c++) {
+    for(int t = 0; t <= Piece::LAST_TYPE; t++) {
+      for(int sq = 0; sq < BOARDSIZE*BOARDSIZE; sq++) {
+        m_zobrist_pieces[c][t][sq] = random64(seed);
+      }
+    }
+  }
+  for(int sq = 0; sq < BOARDSIZE*BOARDSIZE; sq++) {
+    m_zobrist_castling[sq] = random64(seed);
+  }
+  for(int file = 0; file < BOARDSIZE; file++) {
+    m_zobrist_enpassant[file] = random64(seed);
+  }
+  m_zobrist_side = random64(seed);
+
+  // Piece-square values, white counting positive and black negative
+  for(int sq = 0; sq < BOARDSIZE*BOARDSIZE; sq++) {
+    for(int side = 0; side <= Piece::LAST_COLOR; side++) {
+      // Black looks at the tables from the other side of the board
+      int i = (side == Piece::WHITE) ? sq : sq ^ 56;
+      int sign = (side == Piece::WHITE) ? 1 : -1;
+      int squares[Piece::LAST_TYPE + 1] =
+        { pawnSquares[i], 0, knightSquares[i], bishopSquares[i], 0, kingSquares[i] };
+
+      for(int t = 0; t <= Piece::LAST_TYPE; t++) {
+        m_psq_middlegame_table[side][t][sq] = sign * (m_piece_value[t] + squares[t]);
+        m_psq_endgame_table[side][t][sq] = m_psq_middlegame_table[side][t][sq];
+      }
+      m_psq_endgame_table[side][Piece::KING][sq] = sign * endgameKingSquares[i];
+    }
+  }
 
-        bp = BoardPosition(file, rank);
-        occupied = false;
-        
-        // Search to the northeast
-        for(bp.moveNE(); !bp.outNE() && ! occupied; bp.moveNE()) {
-          diagAttacksNE[rank*BOARDSIZE + file][state] |= getMask(bp);
-          shift = (rank < file) ? bp.rank0() : bp.rank0() - (rank-file);
-          occupied = (state >> shift) & 1LL;
-        }
+  // Squares strictly between two squares on a common line
+  for(int a = 0; a < BOARDSIZE*BOARDSIZE; a++) {
+    for(int b = 0; b < BOARDSIZE*BOARDSIZE; b++) {
+      m_between[a][b] = 0LL;
+      if(rookAttacks(a, 0LL) & (1ULL << b)) {
+        m_between[a][b] = rookAttacks(a, 1ULL << b) & rookAttacks(b, 1ULL << a);
+      } else if(bishopAttacks(a, 0LL) & (1ULL << b)) {
+        m_between[a][b] = bishopAttacks(a, 1ULL << b) & bishopAttacks(b, 1ULL << a);
       }
     }
   }
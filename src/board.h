@@ -15,27 +15,33 @@
 
 #include "bitboard.h"
 #include "boardmove.h"
+#include "move.h"
 
 using std::vector;
 
-struct SerialBoard {
-  unsigned long long pieces[Piece::LAST_TYPE+1];
-  unsigned long long color[Piece::LAST_COLOR+1];
-  union {
-    int all_flags;
-    struct {
-      int white_enpassant:8;
-      int black_enpassant:8;
-      int white_turn:1;
-      int wk_castling:1;
-      int wq_castling:1;
-      int bk_castling:1;
-      int bq_castling:1;
-      int:11;
-    };
-  };
+/**
+ * What Board::makeMove changes that cannot be read back from the move
+ * itself, so that Board::unmakeMove can restore it. King positions and
+ * piece counts are restored from the move and the captured piece.
+ */
+struct UndoInfo {
+  unsigned long long enpassant_flags;
+  unsigned long long castling_flags;
+  unsigned long long hash;
+  Piece::Type moved;
+  Piece::Type captured;
+  int captured_square;
+  int psq_middlegame;
+  int psq_endgame;
+  int material;
+  unsigned long long pawn_hash;
 };
 
+// Sliding attacks can be indexed with the BMI2 PEXT instruction
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NICECHESS_PEXT
+#endif
+
 /**
  * This class represents a chess board.
  */
@@ -173,31 +179,111 @@ class Board {
   bool isEnPassantSet(const BoardPosition & bp) const
     { return (0 != (getMask(bp) & m_enpassant_flags)); }
 
+  /**
+   * Sets the castling rights, e.g. as read from a FEN record. A right is
+   * only kept while the king and the rook have not moved.
+   */
+  void setCastling(bool wk, bool wq, bool bk, bool bq);
+
+  /**
+   * Marks 'bp' as the square a pawn may capture onto en passant.
+   * @param bp - The square skipped over by a double pawn push.
+   */
+  void setEnPassant(const BoardPosition & bp);
+
+  /** Returns the color whose turn it is, makeMove passes the turn on. */
+  Piece::Color getSideToMove() const
+    { return m_side_to_move; }
+
+  /** Sets whose turn it is, e.g. as read from a FEN record. */
+  void setSideToMove(Piece::Color c);
+
+  /**
+   * Returns the Zobrist key of the position. It covers the pieces, the
+   * side to move, the castling rights and the en passant file and is
+   * kept up to date by every function changing the board.
+   */
+  unsigned long long getHash() const
+    { return m_hash; }
+
+  /**
+   * Returns the Zobrist key of the pawns alone, for caching pawn
+   * structure evaluation. Kept up to date like getHash().
+   */
+  unsigned long long getPawnHash() const
+    { return m_pawn_hash; }
+
+  /**
+   * Fills 'moves' with the legal moves of color 'c'.
+   * @param findOne - Stop as soon as one legal move is found.
+   */
+  void generateMoves(Piece::Color c, MoveList & moves, bool findOne=false) const;
+
+  /**
+   * Fills 'moves' with the legal captures and promotions of color 'c',
+   * en passant included. In check these are only the ones that get the
+   * king out of it.
+   */
+  void generateCaptures(Piece::Color c, MoveList & moves) const;
+
+  /**
+   * Static exchange evaluation. Returns the material in centipawns the
+   * side playing 'm' wins, or loses if negative, when both sides keep
+   * capturing on the destination square with their least valuable
+   * piece and each may stop when that is better. Sliders joining the
+   * exchange from behind other attackers are counted, pins are not.
+   * @param m - A legal move, usually a capture or a promotion.
+   */
+  int see(const Move & m) const;
+
+  /**
+   * Returns the pieces of color 'c' that the opponent could capture
+   * right away winning material, as judged by see().
+   */
+  unsigned long long hangingPieces(Piece::Color c) const;
+
+  /** Returns the legal moves of 'color' as BoardMoves, see generateMoves. */
   vector<BoardMove> possibleMoves(Piece::Color color, bool findOne=false) const;
 
+  /** Converts a Move of the current position into a BoardMove. */
+  BoardMove toBoardMove(const Move & m) const;
+
+  /**
+   * Converts a BoardMove of the current position into a Move. A pawn
+   * reaching the last rank without a promotion piece becomes a queen.
+   */
+  Move toMove(const BoardMove & bm) const;
+
   /** */
   BoardPosition getKing(Piece::Color c) const
     { return m_king_pos[c]; }
   
-  /** */
-  int getRankState(const BoardPosition & bp) const;
-
-  /** */
-  int getFileState(const BoardPosition & bp) const;
+  /** Returns the union of both colors' pieces. */
+  unsigned long long getOccupied() const
+    { return m_color[Piece::WHITE] | m_color[Piece::BLACK]; }
 
-  /** */
-  int getSEDiagState(const BoardPosition & bp) const;
-
-  /** */
-  int getNEDiagState(const BoardPosition & bp) const;
+  /**
+   * Returns the squares a rook on 'sq' attacks when the squares in
+   * 'occupied' block its way.
+   */
+  static unsigned long long rookAttacks(int sq, unsigned long long occupied)
+    { return m_rook_attacks(sq, occupied); }
 
   /**
-   * This function handles the setting and removal of castling and en
-   * passant flags on the specialty flag boards.
-   * @param bm - The BoardMove that just occured.
+   * Returns the squares a bishop on 'sq' attacks when the squares in
+   * 'occupied' block its way.
    */
-  void setSpecialPieceFlags(const BoardMove & bm);
-  
+  static unsigned long long bishopAttacks(int sq, unsigned long long occupied)
+    { return m_bishop_attacks(sq, occupied); }
+
+  /** Returns the squares a queen on 'sq' attacks. */
+  static unsigned long long queenAttacks(int sq, unsigned long long occupied)
+    { return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied); }
+
+  /** Returns true if sliding attacks are indexed with the BMI2 PEXT instruction. */
+  static bool isUsingPext()
+    { return m_use_pext; }
+
   /**
    * Given a valid and legal move, updates the board to reflect the move.
    * This function should only be called from ChessGame::tryMove.
@@ -205,11 +291,57 @@ class Board {
    */
   void update(const BoardMove & bm);
 
-  /** */
-  void addPiece(Piece * p, const BoardPosition & bp);
+  /**
+   * Plays a legal move in place and records what is needed to take it
+   * back again with unmakeMove. Used by the search instead of copying
+   * the whole board for every child node.
+   * @param m - The move to play.
+   * @param undo - Filled with the state the move overwrites.
+   */
+  void makeMove(const Move & m, UndoInfo & undo);
+
+  /**
+   * Takes back a move played with makeMove. Moves have to be taken back
+   * in the reverse order they were made.
+   * @param m - The move to take back.
+   * @param undo - The record makeMove filled for this move.
+   */
+  void unmakeMove(const Move & m, const UndoInfo & undo);
+
+  /**
+   * Passes the turn to the other side without moving, for null move
+   * pruning. An en passant capture is no longer possible afterwards.
+   * Must not be used while in check.
+   */
+  void makeNullMove(UndoInfo & undo);
+
+  /** Takes back a move played with makeNullMove. */
+  void unmakeNullMove(const UndoInfo & undo);
+
+  /** Returns true if color 'c' has a piece other than its king and pawns. */
+  bool hasNonPawnMaterial(Piece::Color c) const
+    { return m_piece_count[c][Piece::KNIGHT] || m_piece_count[c][Piece::BISHOP] ||
+             m_piece_count[c][Piece::ROOK] || m_piece_count[c][Piece::QUEEN]; }
+
+  /**
+   * Returns the material and piece-square value of the position from
+   * white's point of view, with the kings valued on their end game
+   * squares if 'endgame'. Kept up to date by every function changing the
+   * board, so the evaluation does not have to look at every piece.
+   */
+  int getPsqScore(bool endgame) const
+    { return endgame ? m_psq_endgame : m_psq_middlegame; }
+
+  /** Returns the material of both sides together, kings left out. */
+  int getMaterial() const
+    { return m_material; }
+
+  /** Returns the value of a piece of type 't' in centipawns, 0 for kings. */
+  static int getPieceValue(Piece::Type t)
+    { return m_piece_value[t]; }
 
   /** */
-  SerialBoard serialize() const;
+  void addPiece(Piece * p, const BoardPosition & bp);
 
   /**
    * This is just the size of the board, useful for looping over a board.
@@ -219,14 +351,106 @@ class Board {
   static unsigned long long pawnAttacks[2][64];
   static unsigned long long knightAttacks[64];
   static unsigned long long kingAttacks[64];
-  static unsigned long long rankAttacks[64][256];
-  static unsigned long long fileAttacks[64][256];
-  static unsigned long long diagAttacksSE[64][256];
-  static unsigned long long diagAttacksNE[64][256];
 
   friend class NicePlayer;
+  friend class Bitbase;
+  friend class OpeningBook;
 
  private:
+  /**
+   * Lookup data of one square for the sliding attack tables. The
+   * blockers inside 'mask' are hashed into an index of 'attacks',
+   * either by multiplying with 'magic' or by the PEXT instruction.
+   */
+  struct Magic {
+    unsigned long long mask;
+    unsigned long long magic;
+    unsigned long long * attacks;
+    int shift;
+  };
+
+  static Magic m_rook_magics[64];
+  static Magic m_bishop_magics[64];
+  static unsigned long long m_rook_table[0x19000];
+  static unsigned long long m_bishop_table[0x1480];
+  static bool m_use_pext;
+
+  // Sliding attack lookups, the PEXT or the magic ones, picked once in init()
+  typedef unsigned long long (*SliderAttacks)(int sq, unsigned long long occupied);
+  static SliderAttacks m_rook_attacks;
+  static SliderAttacks m_bishop_attacks;
+
+  // Squares strictly between two squares sharing a rank, file or diagonal
+  static unsigned long long m_between[64][64];
+
+  // Random keys hashed into m_hash
+  static unsigned long long m_zobrist_pieces[2][6][64];
+  static unsigned long long m_zobrist_castling[64];
+  static unsigned long long m_zobrist_enpassant[8];
+  static unsigned long long m_zobrist_side;
+
+  // Material plus piece-square value of a piece, negative for black
+  static const int m_piece_value[Piece::LAST_TYPE + 1];
+  static int m_psq_middlegame_table[2][6][64];
+  static int m_psq_endgame_table[2][6][64];
+
+  /**
+   * Adds ('sign' 1) or removes ('sign' -1) the value of a piece on 'sq',
+   * and toggles it in the pawn key if it is a pawn.
+   */
+  void updatePsq(Piece::Color c, Piece::Type t, int sq, int sign)
+    { m_psq_middlegame += sign * m_psq_middlegame_table[c][t][sq];
+      m_psq_endgame += sign * m_psq_endgame_table[c][t][sq];
+      m_material += sign * m_piece_value[t];
+      if(t == Piece::PAWN) m_pawn_hash ^= m_zobrist_pieces[c][t][sq]; }
+
+  /** Returns the hash key of the castling rights given by 'flags'. */
+  static unsigned long long castlingKey(unsigned long long flags);
+
+  /** Returns the hash key of the en passant file in 'flags', if any. */
+  static unsigned long long enpassantKey(unsigned long long flags)
+    { return flags ? m_zobrist_enpassant[BitBoard::lsb(flags) & 7] : 0LL; }
+
+  static void initMagics(Magic magics[64], unsigned long long * table, bool rook);
+
+  static unsigned int magicIndex(const Magic & m, unsigned long long occupied)
+    { return (unsigned int)(((occupied & m.mask) * m.magic) >> m.shift); }
+
+  static unsigned long long rookMagicAttacks(int sq, unsigned long long occupied);
+  static unsigned long long bishopMagicAttacks(int sq, unsigned long long occupied);
+#ifdef NICECHESS_PEXT
+  static unsigned long long rookPextAttacks(int sq, unsigned long long occupied);
+  static unsigned long long bishopPextAttacks(int sq, unsigned long long occupied);
+#endif
+
+  /**
+   * Returns the pieces of the color opposing 'c' that attack the square
+   * 'sq' when the squares in 'occupied' block sliding pieces.
+   */
+  unsigned long long attackersTo(int sq, Piece::Color c, unsigned long long occupied) const;
+
+  /**
+   * Returns whether 'm' leaves the king of 'c' in check, worked out from
+   * the squares the move empties and fills without making it.
+   */
+  bool isCheckAfter(const Move & m, Piece::Color c) const;
+
+  /**
+   * Does the work of generateMoves and generateCaptures.
+   * @param capturesOnly - Leave out moves that neither capture nor promote.
+   */
+  void generate(Piece::Color c, MoveList & moves, bool findOne, bool capturesOnly) const;
+
+  /** Returns the type of the piece on 'sq', NOTYPE if it is empty. */
+  Piece::Type typeAt(int sq) const
+    { return Piece::Type(m_mailbox[sq] & 7); }
+
+  /** Returns the mailbox code of a piece, see m_mailbox. */
+  static unsigned char pieceCode(Piece::Color c, Piece::Type t)
+    { return (unsigned char)((c << 3) | t); }
+
+  const static unsigned char EMPTY_SQUARE = Piece::NOTYPE;
+
   static Piece* m_allpieces[Piece::LAST_COLOR + 1][Piece::LAST_TYPE + 1];
   static bool m_setup;
 
@@ -239,14 +463,25 @@ class Board {
   unsigned long long m_enpassant_flags;
   unsigned long long m_castling_flags;
 
+  // The piece on every square as color << 3 | type, or EMPTY_SQUARE. Kept
+  // in step with the bitboards so that getPiece is a single array read.
+  unsigned char m_mailbox[64];
+
+  Piece::Color m_side_to_move;
+  unsigned long long m_hash;
+
+  // See getPsqScore, getMaterial and getPawnHash
+  int m_psq_middlegame;
+  int m_psq_endgame;
+  int m_material;
+  unsigned long long m_pawn_hash;
+
   // Nice to have this around
   BoardPosition m_king_pos[Piece::LAST_COLOR + 1];
 
   inline void unsetAllBits(const BoardPosition & bp);
 };
 
-static int pow2[8];
-
 std::ostream& operator<< (std::ostream & os, const Board & b);
 
 inline unsigned long long getMask(const BoardPosition & bp)
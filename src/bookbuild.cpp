@@ -0,0 +1,356 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : bookbuild.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "chessgamestate.h"
+#include "openingbook.h"
+
+using namespace std;
+
+static const string START_FEN =
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+/**
+ * Results of the games in which one move was played in one position,
+ * seen from the side playing it.
+ */
+struct MoveStats {
+  MoveStats() : games(0), wins(0), draws(0) {}
+
+  int games;
+  int wins;
+  int draws;
+};
+
+typedef map<pair<unsigned long long, unsigned short>, MoveStats> BookMap;
+
+static Piece::Type pieceType(char c)
+{
+  switch (c)
+  {
+    case 'N': return Piece::KNIGHT;
+    case 'B': return Piece::BISHOP;
+    case 'R': return Piece::ROOK;
+    case 'Q': return Piece::QUEEN;
+    case 'K': return Piece::KING;
+    default:  return Piece::NOTYPE;
+  }
+}
+
+/**
+ * Finds the legal move of the side to move written as 'san' in standard
+ * algebraic notation. Returns the null move if there is none.
+ */
+static Move parseSan(const Board & board, string san)
+{
+  MoveList moves;
+  board.generateMoves(board.getSideToMove(), moves);
+
+  // Check marks and annotations
+  while (!san.empty() && string("+#!?").find(san[san.size() - 1]) != string::npos) {
+    san.erase(san.size() - 1);
+  }
+
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+    bool kingSide = (san.size() == 3);
+    for (int i = 0; i < moves.size(); i++) {
+      if (moves[i].kind() == Move::CASTLING && (moves[i].to() > moves[i].from()) == kingSide) {
+        return moves[i];
+      }
+    }
+    return Move();
+  }
+
+  Piece::Type promotion = Piece::NOTYPE;
+  if (san.size() > 2 && pieceType(san[san.size() - 1]) != Piece::NOTYPE) {
+    promotion = pieceType(san[san.size() - 1]);
+    san.erase(san.size() - (san[san.size() - 2] == '=' ? 2 : 1));
+  }
+
+  Piece::Type type = pieceType(san.empty() ? ' ' : san[0]);
+  if (type == Piece::NOTYPE) {
+    type = Piece::PAWN;
+  } else {
+    san.erase(0, 1);
+  }
+
+  if (san.size() < 2) {
+    return Move();
+  }
+
+  int to = (san[san.size() - 2] - 'a') + 8 * (san[san.size() - 1] - '1');
+  int fromFile = -1;
+  int fromRank = -1;
+
+  // What is left in front of the destination narrows down the origin
+  for (int i = 0; i + 2 < (int)san.size(); i++) {
+    if (san[i] >= 'a' && san[i] <= 'h') {
+      fromFile = san[i] - 'a';
+    } else if (san[i] >= '1' && san[i] <= '8') {
+      fromRank = san[i] - '1';
+    }
+  }
+
+  for (int i = 0; i < moves.size(); i++) {
+    const Move & m = moves[i];
+    BoardPosition from(m.from());
+
+    if (m.to() == to && board.getPiece(from)->type() == type && m.promotion() == promotion &&
+        (fromFile < 0 || from.x() == fromFile) && (fromRank < 0 || from.y() == fromRank)) {
+      return m;
+    }
+  }
+
+  return Move();
+}
+
+/**
+ * Reads the next token of a PGN file, skipping comments, variations
+ * and numeric annotation glyphs. Tag pairs are returned whole.
+ */
+static bool nextToken(istream & in, string & token)
+{
+  char c;
+  int depth = 0;
+
+  token.clear();
+
+  while (in.get(c)) {
+    if (c == '{') {
+      while (in.get(c) && c != '}') {}
+    } else if (c == ';') {
+      while (in.get(c) && c != '\n') {}
+    } else if (c == '(') {
+      depth++;
+    } else if (c == ')') {
+      depth--;
+    } else if (depth > 0 || isspace((unsigned char)c)) {
+      continue;
+    } else if (c == '[') {
+      token = "[";
+      while (in.get(c) && c != ']') {
+        token += c;
+      }
+      return true;
+    } else {
+      token = c;
+      while (in.get(c) && !isspace((unsigned char)c) && c != '{' && c != '(' &&
+             c != ')' && c != ';' && c != '[') {
+        token += c;
+      }
+      if (in) {
+        in.putback(c);
+      }
+      if (token[0] != '$') {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Adds the first 'plies' moves of one game to 'book'.
+ * @param result - 1 if white won, -1 if black won, 0 otherwise.
+ */
+static void addGame(BookMap & book, const string & fen, const vector<string> & moves,
+                    int result, int plies)
+{
+  ChessGameState cgs;
+
+  if (!cgs.setFen(fen.empty() ? START_FEN : fen)) {
+    return;
+  }
+
+  Board board = cgs.getBoard();
+  UndoInfo undo;
+
+  for (int i = 0; i < (int)moves.size() && i < plies; i++) {
+    Move m = parseSan(board, moves[i]);
+    if (m.isNull()) {
+      cerr << "Illegal move " << moves[i] << ", rest of the game skipped" << endl;
+      return;
+    }
+
+    int score = (board.getSideToMove() == Piece::WHITE) ? result : -result;
+    MoveStats & stats = book[make_pair(OpeningBook::key(board), OpeningBook::encodeMove(m))];
+    stats.games++;
+    stats.wins += (score > 0);
+    stats.draws += (score == 0);
+
+    board.makeMove(m, undo);
+  }
+}
+
+static int gameResult(const string & token)
+{
+  if (token == "1-0") {
+    return 1;
+  } else if (token == "0-1") {
+    return -1;
+  }
+  return 0;
+}
+
+static bool isResult(const string & token)
+{
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+/**
+ * Reads all games of the PGN file 'filename' into 'book'. Returns the
+ * number of games read, -1 if the file can not be read.
+ */
+static int readPgn(BookMap & book, const string & filename, int plies)
+{
+  ifstream in(filename.c_str());
+  if (!in) {
+    return -1;
+  }
+
+  vector<string> moves;
+  string fen;
+  string token;
+  int games = 0;
+
+  while (nextToken(in, token)) {
+    if (token[0] == '[') {
+      // A new game starts with its tag pairs
+      if (!moves.empty()) {
+        addGame(book, fen, moves, 0, plies);
+        games++;
+        moves.clear();
+        fen.clear();
+      }
+      if (token.compare(0, 5, "[FEN ") == 0) {
+        size_t first = token.find('"');
+        size_t last = token.rfind('"');
+        if (first != string::npos && last > first) {
+          fen = token.substr(first + 1, last - first - 1);
+        }
+      }
+    } else if (isResult(token)) {
+      addGame(book, fen, moves, gameResult(token), plies);
+      games++;
+      moves.clear();
+      fen.clear();
+    } else if (token.find('.') != string::npos) {
+      // Move numbers, maybe glued to their move like "1.e4"
+      string move = token.substr(token.rfind('.') + 1);
+      if (!move.empty()) {
+        moves.push_back(move);
+      }
+    } else if (!isdigit((unsigned char)token[0]) || token.compare(0, 3, "0-0") == 0) {
+      moves.push_back(token);
+    }
+  }
+
+  if (!moves.empty()) {
+    addGame(book, fen, moves, 0, plies);
+    games++;
+  }
+
+  return games;
+}
+
+static void printUsage()
+{
+  cerr << "Usage: bookbuild [options] BOOK_FILE PGN_FILE..." << endl;
+  cerr << " -h   Print this help screen." << endl;
+  cerr << " -p   PLIES  Only use the first PLIES moves of every game. (24)" << endl;
+  cerr << " -m   GAMES  Leave out moves played in fewer games. (1)" << endl;
+  cerr << endl;
+  cerr << "Moves are weighted two points per win and one per draw." << endl;
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int plies = 24;
+  int minGames = 1;
+  vector<string> files;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "-h") {
+      printUsage();
+    } else if (arg == "-p" && i + 1 < argc) {
+      plies = atoi(argv[++i]);
+    } else if (arg == "-m" && i + 1 < argc) {
+      minGames = atoi(argv[++i]);
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  if (files.size() < 2 || plies < 1) {
+    printUsage();
+  }
+
+  Board::init();
+
+  BookMap book;
+  int games = 0;
+
+  for (int i = 1; i < (int)files.size(); i++) {
+    int count = readPgn(book, files[i], plies);
+    if (count < 0) {
+      cerr << "Can not read " << files[i] << endl;
+      return 1;
+    }
+    games += count;
+  }
+
+  // Weights have to fit in 16 bits
+  int maxWeight = 1;
+  for (BookMap::iterator it = book.begin(); it != book.end(); ++it) {
+    int weight = 2 * it->second.wins + it->second.draws;
+    if (weight > maxWeight) {
+      maxWeight = weight;
+    }
+  }
+
+  vector<OpeningBook::Entry> entries;
+  for (BookMap::iterator it = book.begin(); it != book.end(); ++it) {
+    int weight = 2 * it->second.wins + it->second.draws;
+    if (it->second.games < minGames || weight == 0) {
+      continue;
+    }
+
+    OpeningBook::Entry e;
+    e.key = it->first.first;
+    e.move = it->first.second;
+    e.weight = (unsigned short)(maxWeight > 0xffff ? (weight * 0xffffLL + maxWeight - 1) / maxWeight
+                                                   : weight);
+    e.learn = 0;
+    entries.push_back(e);
+  }
+
+  if (!OpeningBook::write(files[0], entries)) {
+    cerr << "Can not write " << files[0] << endl;
+    return 1;
+  }
+
+  cout << "Games: " << games << endl;
+  cout << "Entries: " << entries.size() << endl;
+
+  return 0;
+}
+
+// End of file bookbuild.cpp
@@ -0,0 +1,79 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : booktest.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "board.h"
+#include "chessgamestate.h"
+#include "openingbook.h"
+
+using namespace std;
+
+/** A position and its key as published with the Polyglot book format. */
+struct KeyTest {
+  const char * fen;
+  unsigned long long key;
+};
+
+static const KeyTest tests[] = {
+  { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    0x463b96181691fc9cULL },
+  { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+    0x823c9b50fd114196ULL },
+  { "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2",
+    0x0756b94461c50fb0ULL },
+  { "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2",
+    0x662fafb965db29d4ULL },
+  { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    0x22a48b5a8e47ff78ULL },
+  { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3",
+    0x652a607ca3f242c1ULL },
+  { "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4",
+    0x00fdd303c946bdd9ULL },
+  { "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3",
+    0x3c8123ea7b067637ULL },
+  { "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4",
+    0x5c3f9b829b279560ULL },
+};
+
+/**
+ * Checks the position keys against those published with the Polyglot
+ * book format, the first one being the start position. Exits with 1 if
+ * any of them differs.
+ */
+int main()
+{
+  Board::init();
+
+  int failed = 0;
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    ChessGameState cgs;
+
+    if (!cgs.setFen(tests[i].fen)) {
+      cerr << "Invalid FEN: " << tests[i].fen << endl;
+      failed++;
+      continue;
+    }
+
+    unsigned long long key = OpeningBook::key(cgs.getBoard());
+    if (key != tests[i].key) {
+      cerr << tests[i].fen << ": key " << hex << setw(16) << setfill('0') << key
+           << ", expected " << setw(16) << tests[i].key << dec << endl;
+      failed++;
+    }
+  }
+
+  cout << "Failed: " << failed << endl;
+
+  return failed ? 1 : 0;
+}
+
+// End of file booktest.cpp
@@ -8,9 +8,10 @@
 
 #include "chessgamestate.h"
 
-using namespace std;
+#include <cctype>
+#include <sstream>
 
-inline bool compareBoards(SerialBoard, SerialBoard);
+using namespace std;
 
 void ChessGameState::reset()
 {
@@ -25,7 +26,7 @@ void ChessGameState::reset()
   bIsBlackCanCastleQueenSide = true;
   
   m_last_move = BoardMove();
-  m_threefold_count.clear();
+  m_history.clear();
   m_board.reset();
 
   if (false)
@@ -50,9 +51,7 @@ void ChessGameState::reset()
     {
       BoardPosition bp(auiData[i], auiData[i+1]);
 
-      Piece * piece = new Piece((Piece::Color)(auiData[i+2]), (Piece::Type)(auiData[i+3]));
-      m_pieces[bp.hash()] = piece;
-      m_board.addPiece(piece, bp);
+      addPiece((Piece::Color)(auiData[i+2]), (Piece::Type)(auiData[i+3]), bp);
     }
 
     return;
@@ -81,11 +80,11 @@ void ChessGameState::reset()
         type = Piece::KING;
       }
 
-      Piece* piece = new Piece(color, type);
-      m_pieces[bp.hash()] = piece;
-      m_board.addPiece(piece, bp);
+      addPiece(color, type, bp);
     }
   }
+
+  m_history.push_back(m_board.getHash());
 }
 
 void ChessGameState::load()
@@ -96,7 +95,7 @@ void ChessGameState::load()
   m_turn_number = 1;
   m_white_turn = true;
   m_last_move = BoardMove();
-  m_threefold_count.clear();
+  m_history.clear();
   m_board.reset();
 
   {
@@ -152,11 +151,11 @@ void ChessGameState::load()
     {
       BoardPosition bp((char)(auiData[i]), auiData[i+1]);
 
-      Piece * piece = new Piece((Piece::Color)(auiData[i+2]), (Piece::Type)(auiData[i+3]));
-      m_pieces[bp.hash()] = piece;
-      m_board.addPiece(piece, bp);
+      addPiece((Piece::Color)(auiData[i+2]), (Piece::Type)(auiData[i+3]), bp);
     }
   }
+
+  m_history.push_back(m_board.getHash());
 }
 
 bool ChessGameState::isDraw()
@@ -173,25 +172,17 @@ bool ChessGameState::isDraw()
 // onto the stack to handle the various animations and endgame scenarios.
 void ChessGameState::update(const BoardMove& bm)
 {
-  SerialBoard sb;
-  
   if(m_turn_number > 1 && m_last_move.needPromotion()) {
     return;
   }
 
-  // Handle the start of a game
-  if(m_turn_number == 1 && m_white_turn) {
-    sb = m_board.serialize();
-    sb.white_turn = 1;
-    m_threefold_count.push_back(make_pair(sb, 1));
-  }
-
-  if(m_board.getPiece(bm.origin())->type() != Piece::PAWN ||
+  // Positions before a capture or a pawn move can not come back
+  if(m_board.getPiece(bm.origin())->type() == Piece::PAWN ||
      m_board.isOccupied(bm.dest())) {
-    m_50_moves++;
-  } else {
     m_50_moves = 0;
-    m_threefold_count.clear();
+    m_history.clear();
+  } else {
+    m_50_moves++;
   }
 
   m_board.update(bm);
@@ -274,31 +265,29 @@ void ChessGameState::update(const BoardMove& bm)
     }    
   }
   
-  m_pieces[bm.dest().hash()] = m_pieces[bm.origin().hash()];
-  m_pieces[bm.dest().hash()]->promotePawn(bm.getPromotion());
+  // The board already has the promoted piece
+  m_pieces[bm.dest().hash()] = m_board.getPiece(bm.dest());
   m_pieces[bm.origin().hash()] = NULL;
   
   m_check = m_board.isCheck(getTurn());
 
-  // Update the threefold repetition counter
-  int i = 0;
-  sb = m_board.serialize();
-  sb.white_turn = m_white_turn ? 1 : 0;
+  // Update the threefold repetition counter. Only every other position
+  // has the same side to move.
+  unsigned long long hash = m_board.getHash();
+  int count = 1;
 
-  for(; i < (int)m_threefold_count.size(); i++) {
-    if(compareBoards(sb, m_threefold_count[i].first)) {
-      m_threefold_count[i].second++;
-      if(m_threefold_count[i].second >= 3) {
-        m_threefold = true;
-      }
-      break;
+  for(int i = (int)m_history.size() - 2; i >= 0; i -= 2) {
+    if(m_history[i] == hash) {
+      count++;
     }
   }
 
-  if(i == m_threefold_count.size()) {
-    m_threefold_count.push_back(make_pair(sb, 1));
+  if(count >= 3) {
+    m_threefold = true;
   }
 
+  m_history.push_back(hash);
+
   cout << m_turn_number << ". " << (m_white_turn?"...":"") << bm.origin() << bm.dest() << endl;
 
   if(m_white_turn) {
@@ -317,20 +306,6 @@ bool ChessGameState::isPositionSelectable(const BoardPosition& bp) const
   return true;
 }
 
-inline bool compareBoards(SerialBoard x, SerialBoard y) {
-  for(int i=0; i < Piece::LAST_TYPE; i++) {
-    if(x.pieces[i] != y.pieces[i]) {
-      return false;
-    }
-  }
-
-  if((x.color[0] != y.color[0]) || (x.color[1] != y.color[1])) {
-    return false;
-  }
-
-  return x.all_flags == y.all_flags;
-}
-
 std::string ChessGameState::getFen() const
 {
   std::string fen;
@@ -437,4 +412,131 @@ std::string ChessGameState::getFen() const
   return fen;
 }
 
+bool ChessGameState::setFen(const std::string & fen)
+{
+  std::istringstream iss(fen);
+  std::string placement;
+  std::string turn;
+  std::string castling;
+  std::string enpassant;
+  int rank;
+  char file;
+
+  reset();
+
+  if (!(iss >> placement >> turn >> castling >> enpassant))
+  {
+    return false;
+  }
+
+  if (turn != "w" && turn != "b")
+  {
+    return false;
+  }
+
+  // The optional clocks default to a fresh game
+  if (!(iss >> m_50_moves >> m_turn_number))
+  {
+    m_50_moves = 0;
+    m_turn_number = 1;
+  }
+
+  m_board.reset();
+  m_history.clear();
+
+  for (int i = 0; i < Board::BOARDSIZE*Board::BOARDSIZE; i++)
+  {
+    m_pieces[i] = NULL;
+  }
+
+  rank = 8;
+  file = 'a';
+
+  for (size_t i = 0; i < placement.length(); i++)
+  {
+    char c = placement[i];
+    Piece::Type type;
+
+    if (c == '/')
+    {
+      rank--;
+      file = 'a';
+      continue;
+    }
+    else if (c >= '1' && c <= '8')
+    {
+      file += c - '0';
+      continue;
+    }
+
+    switch (tolower(c))
+    {
+      case 'p': { type = Piece::PAWN; break; }
+      case 'r': { type = Piece::ROOK; break; }
+      case 'n': { type = Piece::KNIGHT; break; }
+      case 'b': { type = Piece::BISHOP; break; }
+      case 'q': { type = Piece::QUEEN; break; }
+      case 'k': { type = Piece::KING; break; }
+      default:  { return false; }
+    }
+
+    BoardPosition bp(file, rank);
+
+    if (!bp.isValid())
+    {
+      return false;
+    }
+
+    addPiece(isupper(c) ? Piece::WHITE : Piece::BLACK, type, bp);
+    file++;
+  }
+
+  // Move generation relies on both kings being there
+  if (m_board.getPieces(Piece::WHITE, Piece::KING).count() != 1 ||
+      m_board.getPieces(Piece::BLACK, Piece::KING).count() != 1)
+  {
+    return false;
+  }
+
+  m_white_turn = (turn == "w");
+  m_board.setSideToMove(getTurn());
+
+  bIsWhiteCanCastleKingSide  = (castling.find('K') != string::npos);
+  bIsWhiteCanCastleQueenSide = (castling.find('Q') != string::npos);
+  bIsBlackCanCastleKingSide  = (castling.find('k') != string::npos);
+  bIsBlackCanCastleQueenSide = (castling.find('q') != string::npos);
+
+  m_board.setCastling(
+    bIsWhiteCanCastleKingSide,
+    bIsWhiteCanCastleQueenSide,
+    bIsBlackCanCastleKingSide,
+    bIsBlackCanCastleQueenSide
+  );
+
+  if (enpassant != "-")
+  {
+    BoardPosition bp(enpassant[0], enpassant[1] - '0');
+
+    if (!bp.isValid())
+    {
+      return false;
+    }
+
+    m_board.setEnPassant(bp);
+  }
+
+  m_check = m_board.isCheck(getTurn());
+  m_history.push_back(m_board.getHash());
+
+  return true;
+}
+
+void ChessGameState::addPiece(Piece::Color c, Piece::Type t, const BoardPosition & bp)
+{
+  Piece piece(c, t);
+
+  m_board.addPiece(&piece, bp);
+  m_pieces[bp.hash()] = m_board.getPiece(bp);
+}
+
 // end of file chessgamestate.cpp
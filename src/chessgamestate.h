@@ -71,13 +71,35 @@ class ChessGameState {
   int getTurnNumber() const
     { return m_turn_number; }
 
+  /**
+   * Returns the Zobrist keys of the positions since the last capture or
+   * pawn move, the current position last. A search can keep pushing
+   * onto a copy of it to find repetitions.
+   */
+  const std::vector<unsigned long long> & getHistory() const
+    { return m_history; }
+
   std::string getFen() const;
+
+  /**
+   * Sets up the game from a FEN record.
+   * Returns false if the record could not be parsed or does not have
+   * exactly one king of each color.
+   * @param - fen - The Forsyth-Edwards Notation of the position.
+   */
+  bool setFen(const std::string & fen);
   
   friend class ChessGame;
 
   private:
 
-  std::vector<std::pair<SerialBoard, int> > m_threefold_count;
+  /**
+   * Puts a piece on the board. The squares point to the pieces the
+   * Board keeps, so the game state never has pieces of its own to free.
+   */
+  void addPiece(Piece::Color c, Piece::Type t, const BoardPosition & bp);
+
+  std::vector<unsigned long long> m_history;
   Piece* m_pieces[Board::BOARDSIZE*Board::BOARDSIZE];
   Board m_board;
   BoardMove m_last_move;
@@ -14,7 +14,9 @@
 #include "boardmove.h"
 #include "chessgamestate.h"
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 class ChessPlayer {
  public:
@@ -56,6 +58,13 @@ class ChessPlayer {
 
   virtual BoardMove getMove()
     { return m_move; }
+
+  /**
+   * Returns the line of play the player expects after its current or
+   * last move, if it tells.
+   */
+  virtual std::vector<BoardMove> getPrincipalVariation()
+    { return std::vector<BoardMove>(); }
   
   virtual void setThinking(bool is_thinking)
     { m_is_thinking = is_thinking; }    
@@ -84,7 +93,8 @@ class ChessPlayer {
 
   bool m_is_white;
   bool m_is_thinking;
-  bool m_is_stop_thinking;
+  // Set by the main thread while the player thinks on another one
+  std::atomic<bool> m_is_stop_thinking;
   bool m_is_human;  
   bool m_trustworthy;
   BoardMove m_move;
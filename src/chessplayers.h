@@ -8,19 +8,29 @@
 
 #ifdef INCHESSPLAYER_H
 
+#include <atomic>
 #include <vector>
 
+#include "bitbase.h"
+#include "enginereader.h"
+#include "openingbook.h"
+#include "pawnhashtable.h"
+#include "transpositiontable.h"
+
 using std::vector;
 
 class HumanPlayer : public ChessPlayer {
  public:
   HumanPlayer();
+  ~HumanPlayer();
 
   /**
-   * Kills time while the Human user thinks about what move he/she
-   * wants to make.
+   * Sleeps while the Human user thinks about what move he/she wants to
+   * make, until sendMove() or setStopThinking() wakes it up.
    */
   void think(const ChessGameState & cgs);
+
+  void setStopThinking(bool is_stop_thinking);
   
   /**
    * Returns true because the Human user needs to input a move before
@@ -32,37 +42,242 @@ class HumanPlayer : public ChessPlayer {
    * Sets the specified move as this players move to make.
    */
   void sendMove(const BoardMove & m);
+
+ private:
+  // Guard the move and the stop flag between the main thread and think()
+  SDL_mutex * m_mutex;
+  SDL_cond * m_cond;
 };
 
 class NicePlayer : public ChessPlayer {
  public:
   NicePlayer();
+  ~NicePlayer();
+  void newGame();
+  void startGame();
   void think(const ChessGameState & cgs);
   void opponentMove(const BoardMove & move, const ChessGameState & cgs);
 
+  /**
+   * Searches 'cgs' to exactly 'depth' plies on one thread, ignoring the
+   * time budget, and returns the number of nodes searched.
+   */
+  unsigned long benchmark(const ChessGameState & cgs, int depth);
+
+  /**
+   * Returns the line of play the last completed search iteration expects,
+   * starting with the move it would play. Safe to call while thinking.
+   * While pondering, the line is the one of the position pondered on.
+   */
+  std::vector<BoardMove> getPrincipalVariation();
+
+  /** Counters of one search, summed over its threads. */
+  struct SearchStats {
+    SearchStats() : nodes(0), cutoffs(0), first_move_cutoffs(0),
+      pawn_hits(0), pawn_misses(0) {}
+
+    void add(const SearchStats & s)
+      { nodes += s.nodes; cutoffs += s.cutoffs;
+        first_move_cutoffs += s.first_move_cutoffs;
+        pawn_hits += s.pawn_hits; pawn_misses += s.pawn_misses;
+        tt.add(s.tt); }
+
+    /** Returns the counters as text, for the -ss and -bench output. */
+    std::string toString() const;
+
+    unsigned long nodes;
+    // Nodes that failed high, and how many of them on the first move
+    unsigned long cutoffs;
+    unsigned long first_move_cutoffs;
+    // Pawn hash table probes that found their pawn structure, and not
+    unsigned long long pawn_hits;
+    unsigned long long pawn_misses;
+    TTStats tt;
+  };
+
+  /** Returns the counters of the last search. */
+  const SearchStats & getStats() const
+    { return m_stats; }
+
  protected:
-  int evaluateBoard(const Board & board, Piece::Color color);
-  int search(Board board, Piece::Color color, int depth, int alpha, int beta, BoardMove& move);
-  int pawnBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
-  int knightBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
-  int bishopBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
-  int rookBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
-  int queenBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
-  int kingBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame);
-
-  int numAttackedSquares(const unsigned long long & pieceAttacks);
-
-  bool isIsolatedPawn(const BoardPosition & bp, const Board & board);
-  bool isDoubledPawn(const BoardPosition & bp, const Board & board);
-   
-  // Used to calculate positional bonuses
-  static int m_bishop[64];
-  static int m_knight[64];
-  static int m_wpawn[64];
-  static int m_bpawn[64];
-  static int m_wking[64];
-  static int m_bking[64];
-  static int m_end_king[64];
+  // Deepest ply the move ordering keeps killer moves for
+  const static int MAX_PLY = 64;
+
+  /**
+   * Everything a search thread changes while searching. Each thread
+   * searches its own copy of the board, the transposition table is the
+   * only thing the threads share.
+   */
+  struct SearchThread {
+    NicePlayer * player;
+    int id;
+    Board board;
+    Piece::Color color;
+
+    // Zobrist keys of the game since the last capture or pawn move,
+    // followed by the positions on the current search path
+    vector<unsigned long long> history;
+
+    int root_depth;
+    unsigned long nodes;
+    bool is_stopped;
+    TTStats tt_stats;
+
+    // Quiet moves that caused a beta cutoff, two per ply
+    Move killers[MAX_PLY][2];
+    // Cutoff credit of quiet moves by color, origin and destination
+    int history_table[Piece::LAST_COLOR + 1][64][64];
+
+    // Nodes that failed high, and how many of them on the first move
+    unsigned long cutoffs;
+    unsigned long first_move_cutoffs;
+
+    // Principal variation of every ply of the current path, the one of
+    // ply n being pv[n][n] to pv[n][pv_length[n]-1]
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pv_length[MAX_PLY + 1];
+
+    // Principal variation of the last completed iteration, and whether
+    // the current node is still on it
+    Move prev_pv[MAX_PLY + 1];
+    int prev_pv_length;
+    bool is_on_pv;
+
+    // Pawn structure scores, one table per thread
+    PawnHashTable * pawn_table;
+  };
+
+  // Position a search starts from, with the positions of the game before
+  // it for finding repetitions
+  struct SearchRoot {
+    Board board;
+    Piece::Color color;
+    vector<unsigned long long> history;
+
+    SearchRoot() : color(Piece::WHITE) {}
+    explicit SearchRoot(const ChessGameState & cgs)
+      : board(cgs.getBoard()), color(cgs.getTurn()), history(cgs.getHistory()) {}
+  };
+
+  // A helper search thread, parked on its semaphore between searches.
+  // It searches m_threads[id] when woken.
+  struct HelperThread {
+    NicePlayer * player;
+    int id;
+    SDL_Thread * thread;
+    SDL_sem * wake;
+  };
+
+  static int helperThread(void * data);
+  static int bitbaseThread(void * data);
+  static int ponderThread(void * data);
+
+  int evaluateBoard(const Board & board, Piece::Color color, PawnHashTable & pawnTable);
+  void initSearchThread(SearchThread & t, int id, const SearchRoot & root);
+  void preparePawnTables(int count);
+  int prepareHelpers(int count);
+  void stopThreads();
+  bool probeBook(const ChessGameState & cgs, Move & move);
+  void prepareBitbase();
+  void readSearchOptions();
+  Move searchRoot(const SearchRoot & root);
+  void startPondering(const SearchRoot & root, const Move & move);
+  void stopPondering();
+  bool isPonderHit(const ChessGameState & cgs) const;
+  int aspirationSearch(SearchThread & t, int depth, int score, Move & move);
+  void updatePrincipalVariation(SearchThread & t, const Move & move, int ply);
+  void publishPrincipalVariation(const SearchThread & t);
+  std::string principalVariationString();
+  int search(SearchThread & t, Piece::Color color, int depth, int ply, int alpha, int beta,
+             Move& move, bool isNullAllowed = true);
+  int quiesce(SearchThread & t, Piece::Color color, int ply, int alpha, int beta);
+  bool isStopped(SearchThread & t);
+  static int scoreToTT(int score, int ply);
+  static int scoreFromTT(int score, int ply);
+  void scoreMoves(const SearchThread & t, Piece::Color color, const MoveList & moves,
+                  const Move & hashMove, int ply, int scores[]);
+  static void pickMove(MoveList & moves, int scores[], int i);
+  void updateOrdering(SearchThread & t, Piece::Color color, const Move & move, int depth, int ply);
+  bool isRepetition(const SearchThread & t, unsigned long long hash) const;
+  int pawnBonus(const Board & board, PawnHashTable & pawnTable);
+  static int pawnStructure(const Board & board, Piece::Color c);
+  int mobilityBonus(const Board & board, Piece::Color c);
+  int rookBonus(const Board & board, Piece::Color c);
+  int queenBonus(const Board & board, Piece::Color c, bool endgame);
+  int kingBonus(const Board & board, Piece::Color c, bool endgame);
+
+  // Below this much material on the board kings come out
+  const static int ENDGAME_MATERIAL = 3500;
+
+  // Search results kept from move to move during a game
+  TranspositionTable m_tt;
+  std::vector<PawnHashTable> m_pawn_tables;
+  // State of every search thread, reused by the next search
+  std::vector<SearchThread> m_threads;
+  // Helper threads, started by the first search that wants them and
+  // kept until the player is destroyed
+  std::vector<HelperThread *> m_helpers;
+  SDL_sem * m_helpers_done;
+  // Tells the parked helper and ponder threads to end
+  std::atomic<bool> m_is_quitting;
+  OpeningBook m_book;
+  std::string m_book_filename;
+
+  // Endgame results, generated on a thread of their own if the file is
+  // missing. The file name does not change while that thread runs.
+  Bitbase m_bitbase;
+  std::string m_bitbase_filename;
+  SDL_Thread * m_bitbase_thread;
+  std::atomic<bool> m_is_bitbase_generating;
+  std::atomic<bool> m_is_bitbase_stopped;
+
+  // Pondering: the search of the position expected after the opponent's
+  // reply, run while the opponent thinks on a thread that is started the
+  // first time and parked on m_ponder_wake between moves
+  SDL_Thread * m_ponder_thread;
+  SDL_sem * m_ponder_wake;
+  SDL_sem * m_ponder_done;
+  bool m_is_pondering;
+  SearchRoot m_ponder_root;
+  Move m_ponder_move;
+  unsigned int m_ponder_start;
+  std::atomic<bool> m_is_ponder_stopped;
+  unsigned long m_ponder_hits;
+  unsigned long m_ponder_misses;
+  unsigned long long m_ponder_saved_ms;
+
+  const static int MAX_DEPTH = 32;
+  // Score of being mated at the root, mates further away score less
+  const static int MATE_SCORE = 1000000;
+  // Added to the evaluation of endings the bitbase knows to be won
+  const static int BITBASE_WIN_SCORE = 50000;
+  static int m_think_time_ms[10];
+
+  // Selective search, see search()
+  const static int FUTILITY_DEPTH = 2;
+  const static int FUTILITY_MARGIN = 200;
+  const static int RAZOR_MARGIN = 300;
+  const static int LMR_DEPTH = 3;
+  const static int LMR_MOVES = 4;
+
+  // Aspiration windows start this wide around the previous score from
+  // this depth on, and give way to the full window beyond the limit
+  const static int ASPIRATION_WINDOW = 50;
+  const static int ASPIRATION_DEPTH = 4;
+  const static int ASPIRATION_LIMIT = 1000;
+
+  // Shared by all threads of the current search
+  bool m_is_null_move;
+  bool m_is_late_move_reduction;
+  bool m_is_futility;
+  std::atomic<unsigned int> m_soft_deadline;
+  std::atomic<unsigned int> m_hard_deadline;
+  std::atomic<bool> m_is_helpers_stopped;
+
+  // Principal variation of the last completed iteration
+  std::vector<BoardMove> m_pv;
+  SearchStats m_stats;
+  SDL_mutex * m_pv_mutex;
 };
 
 class RandomPlayer : public ChessPlayer {
@@ -122,6 +337,15 @@ class XboardPlayer : public ChessPlayer {
   void undoMove();
 
   void runChessEngine();
+
+ private:
+  /**
+   * Tells the engine to move now and reads up to its move line, so that
+   * the move of a stopped search is not taken for the next one.
+   */
+  void stopEngine();
+
+  EngineReader m_reader;
 };
 
 /**
@@ -167,6 +391,15 @@ class UciPlayer : public ChessPlayer {
   void undoMove();
 
   void runChessEngine();
+
+ private:
+  /**
+   * Tells the engine to move now and reads up to its bestmove line, so that
+   * the move of a stopped search is not taken for the next one.
+   */
+  void stopEngine();
+
+  EngineReader m_reader;
 };
 
 #endif // #ifndef WIN32
@@ -0,0 +1,101 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : enginereader.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+#ifndef WIN32
+
+#include "enginereader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+EngineReader::EngineReader()
+  : m_fd(-1), m_begin(0), m_end(0), m_scanned(0)
+{
+}
+
+void EngineReader::setFd(int fd)
+{
+  m_fd = fd;
+  m_begin = 0;
+  m_end = 0;
+  m_scanned = 0;
+}
+
+EngineReader::Status EngineReader::readLine(const char ** line, int * length, int timeoutms)
+{
+  for(;;) {
+    char * newline = (char *)memchr(m_buffer + m_scanned, '\n', m_end - m_scanned);
+
+    if(newline || m_end - m_begin == BUFFER_SIZE) {
+      int end = newline ? (int)(newline - m_buffer) : m_end;
+
+      *line = m_buffer + m_begin;
+      *length = end - m_begin;
+      if(*length > 0 && m_buffer[end - 1] == '\r') {
+        (*length)--;
+      }
+
+      m_begin = newline ? end + 1 : end;
+      m_scanned = m_begin;
+      return LINE;
+    }
+    m_scanned = m_end;
+
+    if(m_fd < 0) {
+      // What the engine wrote last before going away, if anything
+      if(m_begin < m_end) {
+        *line = m_buffer + m_begin;
+        *length = m_end - m_begin;
+        m_begin = m_end;
+        m_scanned = m_end;
+        return LINE;
+      }
+      return CLOSED;
+    }
+
+    // Make room behind the unfinished line
+    if(m_begin == m_end) {
+      m_begin = 0;
+      m_end = 0;
+      m_scanned = 0;
+    } else if(m_end == BUFFER_SIZE) {
+      memmove(m_buffer, m_buffer + m_begin, m_end - m_begin);
+      m_end -= m_begin;
+      m_scanned -= m_begin;
+      m_begin = 0;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ready = poll(&pfd, 1, timeoutms);
+    if(ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if(ready == 0) {
+      return TIMEOUT;
+    }
+
+    ssize_t count = (ready < 0) ? -1 : read(m_fd, m_buffer + m_end, BUFFER_SIZE - m_end);
+    if(count < 0 && errno == EINTR) {
+      continue;
+    }
+    if(count <= 0) {
+      m_fd = -1;
+      continue;
+    }
+    m_end += count;
+  }
+}
+
+#endif
+
+// End of file enginereader.cpp
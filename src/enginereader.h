@@ -0,0 +1,55 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : enginereader.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef ENGINEREADER_H
+#define ENGINEREADER_H
+
+/**
+ * Splits the output of a chess engine into lines. The pipe is read in
+ * large chunks into one buffer and the lines are handed out where they
+ * lie in it, without copying. Only the unfinished last line of a chunk
+ * is moved to the front of the buffer before reading on.
+ *
+ * Chatty engines print thousands of lines per move, which this turns
+ * into a few reads instead of one read per byte.
+ */
+class EngineReader {
+ public:
+  enum Status { LINE, TIMEOUT, CLOSED };
+
+  /** How long the players wait for output before looking at their stop flag */
+  const static int STOP_CHECK_MS = 100;
+
+  EngineReader();
+
+  /** Reads from 'fd' from now on, dropping what is buffered. */
+  void setFd(int fd);
+
+  /**
+   * Waits up to 'timeoutms' milliseconds for a line, -1 waiting for ever.
+   * On LINE, 'line' points to 'length' characters of it, without the end
+   * of line. They stay valid until the next call. A line longer than the
+   * buffer comes in pieces. CLOSED means the engine has gone away.
+   */
+  Status readLine(const char ** line, int * length, int timeoutms);
+
+ private:
+  const static int BUFFER_SIZE = 64 * 1024;
+
+  int m_fd;
+  char m_buffer[BUFFER_SIZE];
+  // Unread characters are m_buffer[m_begin] to m_buffer[m_end - 1]
+  int m_begin;
+  int m_end;
+  // Where the search for the next end of line goes on
+  int m_scanned;
+};
+
+#endif
+
+// End of file enginereader.h
@@ -20,6 +20,7 @@
 #include "SDL_thread.h"
 #include "SDL_image.h"
 #include "texture.h"
+#include "thinkworker.h"
 #include "utils.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -50,13 +51,13 @@ GameCore * GameCore::getInstance()
 
 void GameCore::destroy()
 {
-  if (m_thinkthread)
+  if (m_worker.isBusy())
   {
     ChessGame* game = &m_game;
     game->getCurrentPlayer()->setStopThinking(true);
-    SDL_WaitThread(m_thinkthread, NULL);
-    m_thinkthread = NULL;
+    m_worker.wait();
   }
+  m_worker.stop();
 
   delete m_theme;
   m_theme = 0;
@@ -121,8 +122,11 @@ bool GameCore::loadGL()
   m_blankcur = SDL_CreateCursor((Uint8*)blank, (Uint8*)blank, 8, 8, 0, 0);
   m_glloaded = true;
 
-  if(!m_thinkthread) {
-    spawnThinkThread();
+  if(!m_worker.isRunning()) {
+    m_worker.start();
+  }
+  if(!m_worker.isBusy()) {
+    queueThink();
   }
 
   preload();
@@ -509,12 +513,11 @@ bool GameCore::handleEvent(SDL_Event& e)
         m_game.getCurrentPlayer()->opponentMove(player->getMove(), m_game.getState());
         deselectMoveStartPosition();
       }
-      SDL_WaitThread(m_thinkthread, NULL);
-      m_thinkthread = NULL;
+      m_worker.wait();
 
       // Only temporary, really want to do this after animation is done
       if (!(m_game.getBoard().containsCheckMate() || m_game.getState().isDraw())) {
-        spawnThinkThread();
+        queueThink();
       } else {
         m_endgametimer = Timer(Timer::LINEAR);
         m_endgametimer.setDuration(1.0);
@@ -540,6 +543,9 @@ bool GameCore::handleEvent(SDL_Event& e)
     else if (e.user.code == Menu::eHIGHLIGHTPIECETOG) {
       m_options->ishighlightpiece = !m_options->ishighlightpiece;
     }
+    else if (e.user.code == Menu::eHIGHLIGHTHANGINGTOG) {
+      m_options->ishighlighthanging = !m_options->ishighlighthanging;
+    }
     else if (e.user.code == Menu::eHISTORYARROWSTOG) {
       m_theme->toggleHistoryArrows();
     }
@@ -572,12 +578,11 @@ bool GameCore::handleEvent(SDL_Event& e)
       );
     }
     else if (e.user.code == Menu::eSTARTNEWGAME) {
-      if (m_thinkthread)
+      if (m_worker.isBusy())
       {
         ChessGame* game = &m_game;
         game->getCurrentPlayer()->setStopThinking(true);
-        SDL_WaitThread(m_thinkthread, NULL);
-        m_thinkthread = NULL;
+        m_worker.wait();
       }
 
       ChessPlayer * whiteplayer = PlayerFactory(m_suggestedwhiteplayer);
@@ -604,7 +609,7 @@ bool GameCore::handleEvent(SDL_Event& e)
 
       GameCore::getInstance()->requestRepaint();
 
-      spawnThinkThread();
+      queueThink();
 
       SDL_Event backEvent;
       backEvent.type = SDL_USEREVENT;
@@ -920,6 +925,7 @@ void GameCore::buildMenu()
         Shadows           On Off
         Highlight Piece   On Off
         Highlight Square  On Off
+        Hanging Pieces    On Off
         Move Arrow        On Off
         Move Animation    On Off
         Min Move Time     1000
@@ -985,6 +991,7 @@ void GameCore::buildMenu()
     m_menu.addMenuItem("Options", new ToggleItem("Shadows", Menu::eSHADOWTOG, m_options->shadows));
     m_menu.addMenuItem("Options", new ToggleItem("Highlight Piece", Menu::eHIGHLIGHTPIECETOG, m_options->ishighlightpiece));
     m_menu.addMenuItem("Options", new ToggleItem("Highlight Square", Menu::eHIGHLIGHTSQUARETOG, m_options->ishighlightsquare));
+    m_menu.addMenuItem("Options", new ToggleItem("Hanging Pieces", Menu::eHIGHLIGHTHANGINGTOG, m_options->ishighlighthanging));
     m_menu.addMenuItem("Options", new ToggleItem("Move Arrow", Menu::eHISTORYARROWSTOG, m_options->historyarrows));
     m_menu.addMenuItem("Options", new ToggleItem("Move Animation", Menu::eMOVEANIMATIONTOG, m_options->animations));
 
@@ -1097,51 +1104,13 @@ void GameCore::updateMouseBoardPos()
     m_mousepos = BoardPosition((int)floor(world.x), -(int)ceil(world.z));
 }
 
-int callThink(void *pt)
-{
-  ChessGame * game;
-  int starttimems;
-  int endtimems;
-
-  Options* opts = Options::getInstance();
-
-  game = (ChessGame*)pt;
-
-  starttimems = SDL_GetTicks();
-
-  // Give the player time to think
-  game->getCurrentPlayer()->setStopThinking(false);
-  game->getCurrentPlayer()->think(game->getState());
-
-  if (game->getCurrentPlayer()->isStopThinking())
-  {
-    return 0;
-  }
-
-  endtimems = SDL_GetTicks();
-
-  if (endtimems - starttimems < opts->mincomputermovetimems)
-  {
-    SDL_Delay(opts->mincomputermovetimems - (endtimems - starttimems));
-  }
-
-  game->getCurrentPlayer()->setThinking(false);
-
-  // Finished thinking, let the main thread know
-  SDL_Event thinkevent;
-  thinkevent.type = SDL_USEREVENT;
-  thinkevent.user.code = 0;
-  thinkevent.user.data1 = game->getCurrentPlayer();
-  thinkevent.user.data2 = NULL;
-  SDL_PushEvent(&thinkevent);
-  return 0;
-}
-
-void GameCore::spawnThinkThread()
+void GameCore::queueThink()
 {
-  m_thinkthread = SDL_CreateThread(callThink, "think", &m_game);
-  if(m_thinkthread == NULL) {
-    cerr << "Unable to create think thread: " << SDL_GetError() << endl;
+  ThinkWorker::Job job;
+  job.type = ThinkWorker::THINK;
+  job.game = &m_game;
+  if(!m_worker.post(job)) {
+    cerr << "Unable to queue a think job" << endl;
   }
 }
 
@@ -17,6 +17,7 @@
 #include "SDL.h"
 #include "SDL_thread.h"
 #include "texture.h"
+#include "thinkworker.h"
 
 class ChoicesItem;
 class Options;
@@ -111,7 +112,6 @@ class GameCore {
     m_mousex(0),
     m_mousey(0),
     m_mousepos(),
-    m_thinkthread(0),
     m_rotate(false),
     m_rotatex(0),
     m_rotatey(0),
@@ -129,10 +129,11 @@ class GameCore {
   void updateMouseBoardPos();
   void deselectMoveStartPosition();
 
-  SDL_Thread * m_thinkthread;
   SDL_Thread * m_loadthread;
 
-  void spawnThinkThread();
+  // Runs the thinking of the player to move
+  ThinkWorker m_worker;
+  void queueThink();
   
   BoardTheme * m_theme; 
   PieceSet * m_set;
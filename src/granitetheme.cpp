@@ -114,6 +114,15 @@ void GraniteTheme::draw(const ChessGameState & cgs)
     }
   }
   
+  // Mark the pieces of the side to move that can be taken winning
+  // material, judged by the static exchange evaluation alone
+  if (opts->ishighlighthanging) {
+    unsigned long long hanging = cgs.getBoard().hangingPieces(cgs.getTurn());
+    for (int sq : BitBoard(hanging)) {
+      highlightSquare(sq % BOARDSIZE, sq / BOARDSIZE, 0.7, 0.12);
+    }
+  }
+
   drawMoveArrows(cgs);
 
   // Draw the edges of the board
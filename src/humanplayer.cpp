@@ -18,33 +18,44 @@ HumanPlayer::HumanPlayer()
 {
   m_is_human = true;
   m_trustworthy = false;
+  m_mutex = SDL_CreateMutex();
+  m_cond = SDL_CreateCond();
+}
+
+HumanPlayer::~HumanPlayer()
+{
+  SDL_DestroyCond(m_cond);
+  SDL_DestroyMutex(m_mutex);
 }
 
 void HumanPlayer::think(const ChessGameState & cgs)
 {
-//  printf("think\n");
+  SDL_LockMutex(m_mutex);
 
   m_move.invalidate();
 
-  while (true)
+  while (!m_move.isValid() && !m_is_stop_thinking)
   {
-    if (m_move.isValid())
-    {
-      break;
-    }
+    SDL_CondWait(m_cond, m_mutex);
+  }
 
-    if (m_is_stop_thinking)
-    {
-      break;
-    }
+  SDL_UnlockMutex(m_mutex);
+}
 
-    SDL_Delay(50);
-  }
+void HumanPlayer::setStopThinking(bool is_stop_thinking)
+{
+  SDL_LockMutex(m_mutex);
+  m_is_stop_thinking = is_stop_thinking;
+  SDL_CondSignal(m_cond);
+  SDL_UnlockMutex(m_mutex);
 }
 
 void HumanPlayer::sendMove(const BoardMove & m)
 {
+  SDL_LockMutex(m_mutex);
   m_move = m;
+  SDL_CondSignal(m_cond);
+  SDL_UnlockMutex(m_mutex);
 }
 
 // End of file humanplayer.cpp
@@ -80,6 +80,7 @@ class Menu {
     eSHADOWTOG,
     eHIGHLIGHTSQUARETOG,
     eHIGHLIGHTPIECETOG,
+    eHIGHLIGHTHANGINGTOG,
     eMINCOMPUTERMOVETIMECHANGED,
     eSTARTNEWGAME,
     eQUIT,
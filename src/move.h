@@ -0,0 +1,131 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : move.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef MOVE_H
+#define MOVE_H
+
+#include "piece.h"
+
+/**
+ * A move packed into 16 bits for the move generator and the search.
+ * Bits 0-5 hold the destination square, bits 6-11 the origin square,
+ * bits 12-13 the promotion piece and bits 14-15 the kind of move.
+ * Squares are numbered like BoardPosition::hash(). The user interface
+ * and the engine protocols keep using BoardMove, see
+ * Board::toBoardMove and Board::toMove.
+ */
+class Move {
+
+ public:
+
+  /** What has to be done besides moving a piece from origin to dest. */
+  enum Kind { NORMAL = 0, PROMOTION = 1, ENPASSANT = 2, CASTLING = 3 };
+
+  /** Constructs the null move. */
+  Move() : m_data(0) {}
+
+  /**
+   * Constructs a move from 'from' to 'to'.
+   * @param promote - The piece a pawn turns into, only used for PROMOTION.
+   */
+  Move(int from, int to, Kind kind = NORMAL, Piece::Type promote = Piece::ROOK) :
+    m_data((unsigned short)(to | (from << 6) | ((promote - Piece::ROOK) << 12) | (kind << 14))) {}
+
+  /** Returns the origin square. */
+  inline int from() const
+    { return (m_data >> 6) & 0x3f; }
+
+  /** Returns the destination square. */
+  inline int to() const
+    { return m_data & 0x3f; }
+
+  /** Returns the kind of the move. */
+  inline Kind kind() const
+    { return Kind(m_data >> 14); }
+
+  /** Returns the promotion piece, or NOTYPE if this is not a promotion. */
+  inline Piece::Type promotion() const
+    { return kind() == PROMOTION ? Piece::Type(Piece::ROOK + ((m_data >> 12) & 3)) : Piece::NOTYPE; }
+
+  /** Returns true for the null move. */
+  inline bool isNull() const
+    { return m_data == 0; }
+
+  /** Returns the move as its 16 bit code. */
+  inline unsigned short raw() const
+    { return m_data; }
+
+  /** Returns the move with the 16 bit code 'raw', see raw(). */
+  static inline Move fromRaw(unsigned short raw)
+    { Move m; m.m_data = raw; return m; }
+
+  inline bool operator==(const Move & m) const
+    { return m_data == m.m_data; }
+
+  inline bool operator!=(const Move & m) const
+    { return m_data != m.m_data; }
+
+ private:
+
+  unsigned short m_data;
+};
+
+/**
+ * A fixed size list of moves living on the stack, so that generating
+ * moves needs no memory allocation. 256 moves is more than any legal
+ * chess position has.
+ */
+class MoveList {
+
+ public:
+
+  const static int CAPACITY = 256;
+
+  MoveList() : m_size(0) {}
+
+  /** Appends a move to the list. */
+  inline void push(const Move & m)
+    { m_moves[m_size++] = m; }
+
+  /** Returns the number of moves in the list. */
+  inline int size() const
+    { return m_size; }
+
+  inline bool empty() const
+    { return m_size == 0; }
+
+  inline void clear()
+    { m_size = 0; }
+
+  inline Move & operator[](int i)
+    { return m_moves[i]; }
+
+  inline const Move & operator[](int i) const
+    { return m_moves[i]; }
+
+  inline Move * begin()
+    { return m_moves; }
+
+  inline Move * end()
+    { return m_moves + m_size; }
+
+  inline const Move * begin() const
+    { return m_moves; }
+
+  inline const Move * end() const
+    { return m_moves + m_size; }
+
+ private:
+
+  Move m_moves[CAPACITY];
+  int m_size;
+};
+
+#endif // MOVE_H
+
+// End of file move.h
@@ -237,6 +237,13 @@ int main(int argc, char *argv[])
 
   // Parse command line options before doing any screen initialization
   parseCommandLine(argc, argv);
+
+  // Benchmark mode needs no window at all
+  if (opts->benchmarkdepth > 0) {
+    Board::init();
+    runBenchmark(opts->benchmarkdepth);
+    return 0;
+  }
   
   // Screen Settings
   const int WINDOW_WIDTH = opts->windowwidth;
@@ -10,63 +10,796 @@
 #include "chessplayer.h"
 #include "options.h"
 
+#include <iostream>
 #include <vector>
 #include <time.h>
 #include <climits>
+#include <cstring>
+#include <sstream>
 
 #define d1printf(...)
 //#define d1printf(...) printf("%s:%d:", __FUNCTION__, __LINE__); printf(__VA_ARGS__);
 
 using namespace std;
 
+// Time budget per move in milliseconds for each difficulty level. No new
+// iteration is started after half of it, and a running iteration is
+// abandoned when it is used up.
+int NicePlayer::m_think_time_ms[10] = {
+  0, 50, 150, 400, 1000, 2000, 4000, 7000, 10000, 15000
+};
+
+// Move ordering scores. The hash move goes first, then captures and
+// promotions that do not lose material, then the killer moves, the quiet
+// moves by their history, which stays below KILLER_SCORE, and finally
+// the losing captures with negative scores.
+static const int HASH_MOVE_SCORE = 1 << 30;
+static const int CAPTURE_SCORE = 1 << 28;
+static const int KILLER_SCORE = 1 << 26;
+static const int HISTORY_LIMIT = 1 << 24;
+
+// Rough piece values indexed by Piece::Type, for most valuable victim,
+// least valuable attacker ordering
+static const int MVV_LVA_VALUE[Piece::LAST_TYPE + 1] = { 1, 5, 3, 3, 9, 20 };
+
 NicePlayer::NicePlayer()
+  : m_is_quitting(false), m_bitbase_thread(NULL), m_is_bitbase_generating(false),
+    m_is_bitbase_stopped(false), m_ponder_thread(NULL), m_is_pondering(false),
+    m_is_ponder_stopped(false), m_ponder_hits(0), m_ponder_misses(0), m_ponder_saved_ms(0)
 {
   m_trustworthy = true;
   srand(time(NULL));
+  m_tt.resize(Options::getInstance()->hashsizemb);
+  m_pv_mutex = SDL_CreateMutex();
+  m_helpers_done = SDL_CreateSemaphore(0);
+  m_ponder_wake = SDL_CreateSemaphore(0);
+  m_ponder_done = SDL_CreateSemaphore(0);
+}
+
+NicePlayer::~NicePlayer()
+{
+  stopPondering();
+  stopThreads();
+  SDL_DestroySemaphore(m_helpers_done);
+  SDL_DestroySemaphore(m_ponder_wake);
+  SDL_DestroySemaphore(m_ponder_done);
+  if(m_bitbase_thread) {
+    m_is_bitbase_stopped = true;
+    SDL_WaitThread(m_bitbase_thread, NULL);
+  }
+  SDL_DestroyMutex(m_pv_mutex);
+}
+
+void NicePlayer::newGame()
+{
+  stopPondering();
+  m_tt.clear();
+  for(int i = 0; i < (int)m_pawn_tables.size(); i++) {
+    m_pawn_tables[i].clear();
+  }
 }
 
+// A missing bitbase takes a while to generate, so it is started with the
+// game rather than by the first move's search.
+void NicePlayer::startGame()
+{
+  prepareBitbase();
+}
+
+// Plays the best move of a search within the time budget of the
+// difficulty level. If the position is the one pondered on, that search
+// goes on with the time spent so far counted as thinking time, which
+// often leaves nothing more to do. Afterwards the position expected
+// after the opponent's reply is pondered on until the next call.
 void NicePlayer::think(const ChessGameState & cgs)
 {
-  BoardMove move;
-  Board board = cgs.getBoard();
+  Move bestMove;
+  SearchRoot root(cgs);
+  int level = (m_ply < 1) ? 1 : (m_ply > 9) ? 9 : m_ply;
+  unsigned int start = SDL_GetTicks();
+  unsigned int budget = m_think_time_ms[level];
 
   m_is_thinking = true;
 
-  search(board, getColor(), m_ply, -INT_MAX, INT_MAX, move);
+  if(m_is_pondering) {
+    bool isHit = isPonderHit(cgs);
+
+    if(isHit) {
+      m_soft_deadline = m_ponder_start + budget / 2;
+      m_hard_deadline = m_ponder_start + budget;
+      if((int)(start - m_soft_deadline) >= 0) {
+        m_hard_deadline = start;
+      }
+    } else {
+      m_is_ponder_stopped = true;
+    }
+    SDL_SemWait(m_ponder_done);
+    m_is_pondering = false;
+    m_is_ponder_stopped = false;
+
+    if(isHit) {
+      bestMove = m_ponder_move;
+      m_ponder_hits++;
+      m_ponder_saved_ms += start - m_ponder_start;
+      d1printf("ponder hit after %u ms, answered in %u ms\n",
+        start - m_ponder_start, SDL_GetTicks() - start);
+    } else {
+      m_ponder_misses++;
+    }
+  }
+
+  if(bestMove.isNull()) {
+    SDL_LockMutex(m_pv_mutex);
+    m_pv.clear();
+    SDL_UnlockMutex(m_pv_mutex);
+
+    // Book moves are played without searching
+    if(probeBook(cgs, bestMove)) {
+      m_move = cgs.getBoard().toBoardMove(bestMove);
+      d1printf("book move, %lu book entries\n", m_book.getSize());
+      return;
+    }
+
+    prepareBitbase();
+    m_soft_deadline = start + budget / 2;
+    m_hard_deadline = start + budget;
+    bestMove = searchRoot(root);
+    d1printf("searched %u ms\n", SDL_GetTicks() - start);
+  }
+
+  if(Options::getInstance()->issearchstats) {
+    cout << "Search: " << m_stats.nodes << " nodes, " << m_stats.toString() << endl;
+    if(Options::getInstance()->isponder) {
+      cout << "Ponder: " << m_ponder_hits << " hits, " << m_ponder_misses << " misses, "
+           << m_ponder_saved_ms << " ms saved" << endl;
+    }
+  }
 
-  m_move = move;
+  m_move = root.board.toBoardMove(bestMove);
+
+  if(Options::getInstance()->isponder && !m_is_stop_thinking) {
+    startPondering(root, bestMove);
+  }
+}
+
+// Searches one ply deeper at a time until the soft deadline has passed
+// after an iteration, or the hard deadline in the middle of one, and
+// returns the best move of the deepest search that completed. Helper
+// threads search the same position at the same time and only share what
+// they find through the transposition table (Lazy SMP).
+Move NicePlayer::searchRoot(const SearchRoot & root)
+{
+  Move move, bestMove;
+  int helpers = prepareHelpers(Options::getInstance()->searchthreads);
+  vector<SearchThread> & threads = m_threads;
+
+  threads.resize(helpers + 1);
+  m_tt.newSearch();
+  readSearchOptions();
+  m_is_helpers_stopped = false;
+
+  preparePawnTables(threads.size());
+  for(int i = 0; i < (int)threads.size(); i++) {
+    initSearchThread(threads[i], i, root);
+  }
+
+  for(int i = 0; i < helpers; i++) {
+    SDL_SemPost(m_helpers[i]->wake);
+  }
+
+  SearchThread & t = threads[0];
+  int score = 0;
+
+  for(int depth = 1; depth <= MAX_DEPTH; depth++) {
+    score = aspirationSearch(t, depth, score, move);
+
+    if(t.is_stopped) {
+      // Better than nothing if not even one ply was completed
+      if(bestMove.isNull()) {
+        bestMove = move;
+      }
+      break;
+    }
+
+    bestMove = move;
+    publishPrincipalVariation(t);
+
+    d1printf("depth %d score %d nodes %lu first move cutoffs %lu/%lu pv %s\n",
+      depth, score, t.nodes, t.first_move_cutoffs, t.cutoffs,
+      principalVariationString().c_str());
+
+    if((int)(SDL_GetTicks() - m_soft_deadline.load()) >= 0) {
+      break;
+    }
+  }
+
+  m_is_helpers_stopped = true;
+  for(int i = 0; i < helpers; i++) {
+    SDL_SemWait(m_helpers_done);
+  }
+
+  m_stats = SearchStats();
+  for(int i = 0; i < (int)threads.size(); i++) {
+    m_stats.nodes += threads[i].nodes;
+    m_stats.cutoffs += threads[i].cutoffs;
+    m_stats.first_move_cutoffs += threads[i].first_move_cutoffs;
+    m_stats.tt.add(threads[i].tt_stats);
+    m_stats.pawn_hits += threads[i].pawn_table->getHits();
+    m_stats.pawn_misses += threads[i].pawn_table->getMisses();
+  }
+
+  d1printf("threads %d %s\n", helpers + 1, m_stats.toString().c_str());
+  d1printf("tt usage %d/1000\n", m_tt.getUsage());
+
+  return bestMove;
+}
+
+// Searches 'cgs' on one thread to exactly 'depth' plies, without looking
+// at the clock. Returns the number of nodes searched, used to compare
+// search changes on a fixed set of positions.
+unsigned long NicePlayer::benchmark(const ChessGameState & cgs, int depth)
+{
+  SearchThread * t = new SearchThread;
+  Move move;
+  int score = 0;
+
+  m_tt.newSearch();
+  readSearchOptions();
+  m_hard_deadline = SDL_GetTicks() + INT_MAX;
+  preparePawnTables(1);
+  initSearchThread(*t, 0, SearchRoot(cgs));
+
+  for(int d = 1; d <= depth && d <= MAX_DEPTH; d++) {
+    score = aspirationSearch(*t, d, score, move);
+  }
+
+  m_stats = SearchStats();
+  m_stats.nodes = t->nodes;
+  m_stats.cutoffs = t->cutoffs;
+  m_stats.first_move_cutoffs = t->first_move_cutoffs;
+  m_stats.pawn_hits = t->pawn_table->getHits();
+  m_stats.pawn_misses = t->pawn_table->getMisses();
+  m_stats.tt = t->tt_stats;
+  delete t;
+
+  return m_stats.nodes;
+}
+
+string NicePlayer::SearchStats::toString() const
+{
+  ostringstream oss;
+
+  oss.setf(ios::fixed);
+  oss.precision(1);
+  oss << "first move cutoffs " << (cutoffs ? 100.0 * first_move_cutoffs / cutoffs : 0.0)
+      << "% of " << cutoffs;
+
+  unsigned long long pawnProbes = pawn_hits + pawn_misses;
+  oss << ", pawn hash hits " << (pawnProbes ? 100.0 * pawn_hits / pawnProbes : 0.0)
+      << "% of " << pawnProbes;
+  oss << ", tt hits " << tt.hits << " misses " << tt.misses
+      << " collisions " << tt.collisions;
+
+  return oss.str();
+}
+
+void NicePlayer::initSearchThread(SearchThread & t, int id, const SearchRoot & root)
+{
+  t.player = this;
+  t.id = id;
+  t.board = root.board;
+  t.color = root.color;
+  t.history = root.history;
+  t.nodes = 0;
+  t.is_stopped = false;
+  t.tt_stats = TTStats();
+  t.cutoffs = 0;
+  t.first_move_cutoffs = 0;
+  memset(t.killers, 0, sizeof(t.killers));
+  memset(t.history_table, 0, sizeof(t.history_table));
+  t.prev_pv_length = 0;
+  t.pawn_table = &m_pawn_tables[id];
+  t.pawn_table->clearStats();
+}
+
+// Makes sure every search thread has a pawn hash table of the size set
+// in the options. Tables are kept from move to move.
+void NicePlayer::preparePawnTables(int count)
+{
+  int kb = Options::getInstance()->pawnhashsizekb;
+
+  if((int)m_pawn_tables.size() < count) {
+    m_pawn_tables.resize(count);
+  }
+
+  for(int i = 0; i < count; i++) {
+    if(m_pawn_tables[i].getSize() > (unsigned long long)kb << 10 ||
+       m_pawn_tables[i].getSize() * 2 <= (unsigned long long)kb << 10) {
+      m_pawn_tables[i].resize(kb);
+    }
+  }
+}
+
+// Looks 'cgs' up in the opening book set in the options, opening it
+// first if it is not open yet.
+bool NicePlayer::probeBook(const ChessGameState & cgs, Move & move)
+{
+  const string & filename = Options::getInstance()->bookfilename;
+
+  if(filename != m_book_filename) {
+    m_book_filename = filename;
+    m_book.close();
+    if(!filename.empty() && !m_book.open(filename)) {
+      cerr << "Can not read opening book " << filename << endl;
+    }
+  }
+
+  return m_book.probe(cgs.getBoard(), move);
+}
+
+// Opens the endgame bitbase set in the options. A missing file is
+// generated on a thread of its own, and searches go without the bitbase
+// until it is done.
+void NicePlayer::prepareBitbase()
+{
+  const string & filename = Options::getInstance()->bitbasefilename;
+
+  if(m_bitbase_thread) {
+    if(m_is_bitbase_generating) {
+      return;
+    }
+
+    int isDone = 0;
+    SDL_WaitThread(m_bitbase_thread, &isDone);
+    m_bitbase_thread = NULL;
+    if(!isDone) {
+      cerr << "Can not write endgame bitbase " << m_bitbase_filename << endl;
+    } else if(!m_bitbase.open(m_bitbase_filename)) {
+      cerr << "Can not read endgame bitbase " << m_bitbase_filename << endl;
+    }
+  }
+
+  if(filename == m_bitbase_filename) {
+    return;
+  }
+
+  m_bitbase_filename = filename;
+  m_bitbase.close();
+  if(filename.empty() || m_bitbase.open(filename)) {
+    return;
+  }
+
+  d1printf("generating endgame bitbase %s\n", filename.c_str());
+  m_is_bitbase_generating = true;
+  m_bitbase_thread = SDL_CreateThread(bitbaseThread, "bitbase", this);
+  if(!m_bitbase_thread) {
+    m_is_bitbase_generating = false;
+  }
+}
+
+int NicePlayer::bitbaseThread(void * data)
+{
+  NicePlayer * player = (NicePlayer *)data;
+  bool isDone = Bitbase::generate(player->m_bitbase_filename, &player->m_is_bitbase_stopped);
+
+  player->m_is_bitbase_generating = false;
+  return isDone ? 1 : 0;
+}
+
+void NicePlayer::readSearchOptions()
+{
+  Options * opts = Options::getInstance();
+
+  m_is_null_move = opts->isnullmove;
+  m_is_late_move_reduction = opts->islatemovereduction;
+  m_is_futility = opts->isfutility;
+}
+
+// Starts helper threads until there are 'count' of them, and returns how
+// many there are, fewer if no more threads could be created.
+int NicePlayer::prepareHelpers(int count)
+{
+  while((int)m_helpers.size() < count) {
+    HelperThread * h = new HelperThread;
+    h->player = this;
+    h->id = m_helpers.size() + 1;
+    h->wake = SDL_CreateSemaphore(0);
+    h->thread = SDL_CreateThread(helperThread, "search", h);
+    if(h->thread == NULL) {
+      SDL_DestroySemaphore(h->wake);
+      delete h;
+      break;
+    }
+    m_helpers.push_back(h);
+  }
+
+  return ((int)m_helpers.size() < count) ? m_helpers.size() : count;
+}
+
+// Ends the helper and ponder threads, none of which may be searching.
+void NicePlayer::stopThreads()
+{
+  m_is_quitting = true;
+  if(m_ponder_thread) {
+    SDL_SemPost(m_ponder_wake);
+    SDL_WaitThread(m_ponder_thread, NULL);
+    m_ponder_thread = NULL;
+  }
+
+  for(int i = 0; i < (int)m_helpers.size(); i++) {
+    SDL_SemPost(m_helpers[i]->wake);
+    SDL_WaitThread(m_helpers[i]->thread, NULL);
+    SDL_DestroySemaphore(m_helpers[i]->wake);
+    delete m_helpers[i];
+  }
+  m_helpers.clear();
+}
+
+// Entry point of the helper threads. Once woken for a search they keep
+// deepening until the main thread is done, odd ones start a ply deeper so
+// that the threads do not all search the same depth at the same time.
+int NicePlayer::helperThread(void * data)
+{
+  HelperThread & h = *(HelperThread *)data;
+
+  for(;;) {
+    SDL_SemWait(h.wake);
+    if(h.player->m_is_quitting) {
+      return 0;
+    }
+
+    SearchThread & t = h.player->m_threads[h.id];
+    Move move;
+    int score = 0;
+
+    for(int depth = 1 + (t.id & 1); depth <= MAX_DEPTH && !t.is_stopped; depth++) {
+      score = h.player->aspirationSearch(t, depth, score, move);
+    }
+    SDL_SemPost(h.player->m_helpers_done);
+  }
+}
+
+// Starts searching the position expected after 'move' from 'root' and
+// the reply the principal variation predicts, with no time limit. The
+// next think() takes that search over or stops it.
+void NicePlayer::startPondering(const SearchRoot & root, const Move & move)
+{
+  vector<BoardMove> pv = getPrincipalVariation();
+
+  if(pv.size() < 2 || root.board.toMove(pv[0]) != move) {
+    return;
+  }
+
+  m_ponder_root = root;
+  for(int i = 0; i < 2; i++) {
+    UndoInfo undo;
+    m_ponder_root.board.makeMove(m_ponder_root.board.toMove(pv[i]), undo);
+    m_ponder_root.color = Piece::opposite(m_ponder_root.color);
+
+    // Positions before a capture or a pawn move can not come back
+    if(undo.moved == Piece::PAWN || undo.captured != Piece::NOTYPE) {
+      m_ponder_root.history.clear();
+    }
+    m_ponder_root.history.push_back(m_ponder_root.board.getHash());
+  }
+
+  m_ponder_start = SDL_GetTicks();
+  m_soft_deadline = m_ponder_start + INT_MAX;
+  m_hard_deadline = m_ponder_start + INT_MAX;
+  m_ponder_move = Move();
+
+  if(m_ponder_thread == NULL) {
+    m_ponder_thread = SDL_CreateThread(ponderThread, "ponder", this);
+    if(m_ponder_thread == NULL) {
+      return;
+    }
+  }
+  m_is_pondering = true;
+  SDL_SemPost(m_ponder_wake);
+}
+
+void NicePlayer::stopPondering()
+{
+  if(m_is_pondering) {
+    m_is_ponder_stopped = true;
+    SDL_SemWait(m_ponder_done);
+    m_is_pondering = false;
+    m_is_ponder_stopped = false;
+  }
+}
+
+bool NicePlayer::isPonderHit(const ChessGameState & cgs) const
+{
+  return cgs.getTurn() == m_ponder_root.color &&
+    cgs.getBoard().getHash() == m_ponder_root.board.getHash();
+}
+
+// Entry point of the ponder thread, which searches m_ponder_root each
+// time startPondering() wakes it.
+int NicePlayer::ponderThread(void * data)
+{
+  NicePlayer * player = (NicePlayer *)data;
+
+  for(;;) {
+    SDL_SemWait(player->m_ponder_wake);
+    if(player->m_is_quitting) {
+      return 0;
+    }
+
+    player->m_ponder_move = player->searchRoot(player->m_ponder_root);
+    SDL_SemPost(player->m_ponder_done);
+  }
 }
 
 void NicePlayer::opponentMove(const BoardMove & move, const ChessGameState & cgs)
 {
 }
 
-int NicePlayer::search(Board board, Piece::Color color, int depth, int alpha, int beta, BoardMove& move)
+vector<BoardMove> NicePlayer::getPrincipalVariation()
 {
-  BoardMove testMove;
-  Board testBoard = board;
+  SDL_LockMutex(m_pv_mutex);
+  vector<BoardMove> pv = m_pv;
+  SDL_UnlockMutex(m_pv_mutex);
+
+  return pv;
+}
+
+// Searches the root to 'depth' plies in a narrow window around 'score',
+// the result of the previous iteration. A result outside the window only
+// tells which side of it the real score is on, so the window is widened
+// on that side and the search repeated.
+int NicePlayer::aspirationSearch(SearchThread & t, int depth, int score, Move & move)
+{
+  int delta = ASPIRATION_WINDOW;
+  int alpha = -INT_MAX;
+  int beta = INT_MAX;
+
+  if(depth >= ASPIRATION_DEPTH && score > -MATE_SCORE + MAX_PLY && score < MATE_SCORE - MAX_PLY) {
+    alpha = score - delta;
+    beta = score + delta;
+  }
+
+  t.root_depth = depth;
+
+  for(;;) {
+    t.is_on_pv = true;
+    score = search(t, t.color, depth, 0, alpha, beta, move);
+
+    if(t.is_stopped) {
+      return score;
+    }
+
+    delta *= 2;
+    if(score <= alpha && alpha != -INT_MAX) {
+      alpha = (delta > ASPIRATION_LIMIT) ? -INT_MAX : score - delta;
+    } else if(score >= beta && beta != INT_MAX) {
+      beta = (delta > ASPIRATION_LIMIT) ? INT_MAX : score + delta;
+    } else {
+      break;
+    }
+  }
+
+  // The next iteration searches this line first
+  t.prev_pv_length = t.pv_length[0];
+  for(int i = 0; i < t.prev_pv_length; i++) {
+    t.prev_pv[i] = t.pv[0][i];
+  }
+
+  return score;
+}
+
+// Makes the principal variation of the last iteration of 't' available
+// to getPrincipalVariation.
+void NicePlayer::publishPrincipalVariation(const SearchThread & t)
+{
+  Board board = t.board;
+  vector<BoardMove> pv;
+  UndoInfo undo;
+
+  for(int i = 0; i < t.prev_pv_length; i++) {
+    pv.push_back(board.toBoardMove(t.prev_pv[i]));
+    board.makeMove(t.prev_pv[i], undo);
+  }
+
+  SDL_LockMutex(m_pv_mutex);
+  m_pv = pv;
+  SDL_UnlockMutex(m_pv_mutex);
+}
+
+// Returns the principal variation as text, like "e2e4 e7e5 g1f3".
+string NicePlayer::principalVariationString()
+{
+  vector<BoardMove> pv = getPrincipalVariation();
+  ostringstream os;
+
+  for(int i = 0; i < (int)pv.size(); i++) {
+    os << (i ? " " : "") << pv[i].origin() << pv[i].dest();
+  }
+
+  return os.str();
+}
+
+int NicePlayer::search(SearchThread & t, Piece::Color color, int depth, int ply, int alpha, int beta,
+                       Move& move, bool isNullAllowed)
+{
+  Board & board = t.board;
+  Move testMove;
+  UndoInfo undo;
   int moveScore, bestScore = -INT_MAX;
-  vector<BoardMove> moves = board.possibleMoves(color);
+  int alphaOrig = alpha;
+  MoveList moves;
+  int scores[MoveList::CAPACITY];
+  TTEntry entry;
+  Move hashMove;
+  Move pvMove;
+  bool isPv = beta - alpha > 1;
+  bool isOnPv = t.is_on_pv;
 
-  bool gotmove = false;
+  t.pv_length[ply] = ply;
 
-  for(int i=0; i < moves.size(); i++) {
-    if(!board.isMoveLegal(moves[i])) {
-      continue;
+  if(isStopped(t)) {
+    return 0;
+  }
+
+  if(depth <= 0) {
+    return quiesce(t, color, ply, alpha, beta);
+  }
+
+  // Drawn endings need no search, won ones are searched on to find the
+  // way to mate
+  if(ply > 0 && m_bitbase.probe(board) == Bitbase::DRAW) {
+    return 0;
+  }
+
+  // Along the principal variation of the previous iteration its moves
+  // are tried first
+  if(isOnPv && ply < t.prev_pv_length) {
+    pvMove = t.prev_pv[ply];
+  }
+
+  // A deep enough result of an earlier visit may settle this node. The
+  // root always searches, it has to come up with a move, and nodes
+  // searched with an open window do too, to keep the principal variation
+  // whole.
+  if(m_tt.probe(board.getHash(), entry, t.tt_stats)) {
+    hashMove = entry.bestMove();
+
+    if(!isPv && depth < t.root_depth && entry.depth >= depth) {
+      int score = scoreFromTT(entry.score, ply);
+      if(entry.bound() == TTEntry::EXACT ||
+         (entry.bound() == TTEntry::LOWER && score >= beta) ||
+         (entry.bound() == TTEntry::UPPER && score <= alpha)) {
+        return score;
+      }
     }
+  }
 
-    if(!gotmove) {
+  bool inCheck = board.isCheck(color);
+
+  // Selectivity is left out along the principal variation, in check and
+  // around mate scores
+  bool isPrunable = !isPv && ply > 0 && !inCheck &&
+    alpha > -MATE_SCORE + MAX_PLY && beta < MATE_SCORE - MAX_PLY;
+  int staticEval = 0;
+  if(isPrunable && (m_is_null_move || m_is_futility)) {
+    staticEval = evaluateBoard(board, color, *t.pawn_table);
+  }
+
+  if(isPrunable && m_is_futility && depth <= FUTILITY_DEPTH) {
+    // Reverse futility: far enough above beta the opponent will not be
+    // able to catch up in the few plies left
+    if(staticEval - FUTILITY_MARGIN * depth >= beta) {
+      return beta;
+    }
+
+    // Razoring: far below alpha only captures could still help
+    if(staticEval + RAZOR_MARGIN * depth <= alpha) {
+      int score = quiesce(t, color, ply, alpha, alpha + 1);
+      if(t.is_stopped) {
+        return 0;
+      }
+      if(score <= alpha) {
+        return alpha;
+      }
+    }
+  }
+
+  // Null move: if passing still leaves us above beta after a reduced
+  // search, a real move will do at least as well. Not with pawns alone,
+  // where being forced to move can be the very problem (zugzwang), and
+  // never twice in a row.
+  if(isPrunable && m_is_null_move && isNullAllowed && depth >= 2 &&
+     staticEval >= beta && board.hasNonPawnMaterial(color)) {
+    int reduction = (depth > 6) ? 3 : 2;
+
+    board.makeNullMove(undo);
+    t.history.push_back(board.getHash());
+    t.is_on_pv = false;
+    moveScore = -search(t, Piece::opposite(color), depth-1-reduction, ply+1,
+                        -beta, -beta+1, testMove, false);
+    t.history.pop_back();
+    board.unmakeNullMove(undo);
+
+    if(t.is_stopped) {
+      return 0;
+    }
+    if(moveScore >= beta) {
+      return beta;
+    }
+  }
+
+  board.generateMoves(color, moves);
+  if(moves.empty()) {
+    return inCheck ? -MATE_SCORE + ply : 0;
+  }
+  scoreMoves(t, color, moves, pvMove.isNull() ? hashMove : pvMove, ply, scores);
+
+  for(int i=0; i < moves.size(); i++) {
+    pickMove(moves, scores, i);
+
+    if(i == 0) {
       move = moves[i];
-      gotmove = true;
     }
 
-    testBoard = board;
-    testBoard.update(moves[i]);
+    bool followsPv = isOnPv && !pvMove.isNull() && moves[i] == pvMove;
+
+    // Quiet moves, and losing captures, are those ordered after the killers
+    bool isQuiet = scores[i] < KILLER_SCORE;
+
+    board.makeMove(moves[i], undo);
+    bool givesCheck = board.isCheck(Piece::opposite(color));
+
+    // Futility: at the frontier a quiet move will not lift a position
+    // this far below alpha
+    if(isPrunable && m_is_futility && depth == 1 && i > 0 && isQuiet && !givesCheck &&
+       staticEval + FUTILITY_MARGIN <= alpha) {
+      board.unmakeMove(moves[i], undo);
+      continue;
+    }
   
-    if(depth == 0) {
-      moveScore = evaluateBoard(testBoard, color);
+    if(isRepetition(t, board.getHash())) {
+      moveScore = 0;
+      t.pv_length[ply + 1] = ply + 1;
     } else {
-      moveScore = -search(testBoard, Piece::opposite(color), depth-1, -beta, -alpha, testMove);
+      t.history.push_back(board.getHash());
+
+      // Late move reductions: quiet moves this far down the ordering
+      // rarely turn out best, so they get a shallower look first and a
+      // full one only if they beat alpha
+      int reduction = 0;
+      if(m_is_late_move_reduction && !inCheck && !givesCheck && isQuiet &&
+         depth >= LMR_DEPTH && i >= LMR_MOVES) {
+        reduction = (depth >= 6 && i >= 2 * LMR_MOVES) ? 2 : 1;
+      }
+
+      // Principal variation search: the first move is expected to be the
+      // best, the others only have to be shown worse, which a null window
+      // around alpha does cheaply. Only one that turns out better is
+      // searched again with the full window.
+      if(i == 0) {
+        t.is_on_pv = followsPv;
+        moveScore = -search(t, Piece::opposite(color), depth-1, ply+1, -beta, -alpha, testMove);
+      } else {
+        t.is_on_pv = false;
+        moveScore = -search(t, Piece::opposite(color), depth-1-reduction, ply+1,
+                            -alpha-1, -alpha, testMove);
+        if(reduction && moveScore > alpha && !t.is_stopped) {
+          moveScore = -search(t, Piece::opposite(color), depth-1, ply+1, -alpha-1, -alpha, testMove);
+        }
+        if(moveScore > alpha && moveScore < beta && !t.is_stopped) {
+          t.is_on_pv = followsPv;
+          moveScore = -search(t, Piece::opposite(color), depth-1, ply+1, -beta, -alpha, testMove);
+        }
+      }
+
+      t.history.pop_back();
+    }
+
+    board.unmakeMove(moves[i], undo);
+
+    // The score of an interrupted search means nothing
+    if(t.is_stopped) {
+      return 0;
     }
 
     if(moveScore > bestScore) {
@@ -75,298 +808,447 @@ int NicePlayer::search(Board board, Piece::Color color, int depth, int alpha, in
     }
     if(bestScore > alpha) {
       alpha = bestScore;
+      updatePrincipalVariation(t, move, ply);
     }
     if(alpha >= beta) {
+      t.cutoffs++;
+      if(i == 0) {
+        t.first_move_cutoffs++;
+      }
+      updateOrdering(t, color, move, depth, ply);
+      m_tt.store(board.getHash(), depth, scoreToTT(beta, ply), TTEntry::LOWER, move, t.tt_stats);
       return beta;
     }
   }
+
+  m_tt.store(board.getHash(), depth, scoreToTT(bestScore, ply),
+             bestScore > alphaOrig ? TTEntry::EXACT : TTEntry::UPPER, move, t.tt_stats);
   
   return bestScore;
 }
 
-int NicePlayer::evaluateBoard(const Board & board, Piece::Color turn)
-{
-    vector< vector<BoardPosition> > locations(Piece::LAST_TYPE+1);
-    
-    // Raw material balance
-    int balance = 0;
-    int endgamecount = 0;
-            
-    int queenval = 900, rookval = 500, bishopval = 325, knightval = 310, pawnval = 100, kingval = 100000;
-    
-    for(int i=0; i < 64; i++) {
-        BoardPosition bp = BoardPosition(i);
-        if(board.isOccupied(bp)) {
-            Piece *p = board.getPiece(bp);
-            switch(p->type()) {
-                case Piece::QUEEN:
-                    locations[Piece::QUEEN].push_back(bp);
-                    balance += (p->color() == turn) ? queenval : -queenval;
-                    endgamecount += queenval;
-                    break;
-                case Piece::ROOK:
-                    locations[Piece::ROOK].push_back(bp);
-                    balance += (p->color() == turn) ? rookval : -rookval;
-                    endgamecount += rookval;
-                    break;
-                case Piece::BISHOP:
-                    locations[Piece::BISHOP].push_back(bp);
-                    balance += (p->color() == turn) ? bishopval : -bishopval;
-                    endgamecount += bishopval;
-                    break;
-                case Piece::KNIGHT:
-                    locations[Piece::KNIGHT].push_back(bp);
-                    balance += (p->color() == turn) ? knightval : -knightval;
-                    endgamecount += knightval;
-                    break;
-                case Piece::PAWN:
-                    locations[Piece::PAWN].push_back(bp);
-                    balance += (p->color() == turn) ? pawnval : -pawnval;
-                    endgamecount += pawnval;
-                    break;
-                case Piece::KING:
-                    locations[Piece::KING].push_back(bp);
-                    if ((p->color() == turn) && !board.isCheckMate(turn)) {
-                        balance += kingval;
-                    }
-                    else if ((p->color() != turn) && !board.isCheckMate(turn)) {
-                        balance -= kingval;
-                    }
-                    break;
-            }
-        }
+// Makes 'move' followed by the principal variation of the next ply the
+// principal variation of 'ply'.
+void NicePlayer::updatePrincipalVariation(SearchThread & t, const Move & move, int ply)
+{
+  t.pv[ply][ply] = move;
+  for(int i = ply + 1; i < t.pv_length[ply + 1]; i++) {
+    t.pv[ply][i] = t.pv[ply + 1][i];
+  }
+  t.pv_length[ply] = (t.pv_length[ply + 1] > ply + 1) ? t.pv_length[ply + 1] : ply + 1;
+}
+
+// Mate scores count the plies from the root, the table keeps them
+// counting from the stored position so they stay right when the position
+// comes up at another ply.
+int NicePlayer::scoreToTT(int score, int ply)
+{
+  if(score >= MATE_SCORE - MAX_PLY) {
+    return score + ply;
+  } else if(score <= -MATE_SCORE + MAX_PLY) {
+    return score - ply;
+  }
+  return score;
+}
+
+int NicePlayer::scoreFromTT(int score, int ply)
+{
+  if(score >= MATE_SCORE - MAX_PLY) {
+    return score - ply;
+  } else if(score <= -MATE_SCORE + MAX_PLY) {
+    return score + ply;
+  }
+  return score;
+}
+
+// Counts a node and tells whether the search has to stop. Every 1024
+// nodes the main thread looks at the clock, at setStopThinking() and at
+// the end of pondering, so undo, new game and quit get an answer within
+// a millisecond or so. The helpers wait for the main thread to finish.
+bool NicePlayer::isStopped(SearchThread & t)
+{
+  if(t.id == 0) {
+    if((++t.nodes & 1023) == 0 &&
+       (m_is_stop_thinking.load(std::memory_order_relaxed) ||
+        m_is_ponder_stopped.load(std::memory_order_relaxed) ||
+        (int)(SDL_GetTicks() - m_hard_deadline.load(std::memory_order_relaxed)) >= 0)) {
+      t.is_stopped = true;
+    }
+  } else {
+    t.nodes++;
+    if(m_is_helpers_stopped.load(std::memory_order_relaxed)) {
+      t.is_stopped = true;
+    }
+  }
+
+  return t.is_stopped;
+}
+
+// Searches captures and promotions only, until the position is quiet
+// enough to trust evaluateBoard. The side to move may always stand pat,
+// that is decline to capture and take the static evaluation, except when
+// in check where every evasion is searched.
+int NicePlayer::quiesce(SearchThread & t, Piece::Color color, int ply, int alpha, int beta)
+{
+  Board & board = t.board;
+  UndoInfo undo;
+  MoveList moves;
+  int scores[MoveList::CAPACITY];
+  int moveScore, bestScore;
+  bool inCheck = board.isCheck(color);
+
+  if(isStopped(t)) {
+    return 0;
+  }
+
+  if(ply >= MAX_PLY) {
+    return evaluateBoard(board, color, *t.pawn_table);
+  }
+
+  t.pv_length[ply] = ply;
+
+  if(inCheck) {
+    board.generateMoves(color, moves);
+    if(moves.empty()) {
+      return -MATE_SCORE + ply;
     }
+    bestScore = -INT_MAX;
+  } else {
+    bestScore = evaluateBoard(board, color, *t.pawn_table);
+    if(bestScore >= beta) {
+      return bestScore;
+    }
+    if(bestScore > alpha) {
+      alpha = bestScore;
+    }
+    board.generateCaptures(color, moves);
+  }
 
-    // Determine end game or not.  THIS IS A TWEAKABLE VALUE.
-    bool endgame = false;
-    if (endgamecount < 3500) {
-      endgame = true;
+  scoreMoves(t, color, moves, Move(), ply, scores);
+
+  for(int i=0; i < moves.size(); i++) {
+    pickMove(moves, scores, i);
+
+    // Underpromotions and captures losing material, as found by the
+    // static exchange evaluation, are sorted last and left to the full
+    // width search
+    if(!inCheck && scores[i] < 0) {
+      break;
     }
 
-    for(int i=0; i < locations[Piece::QUEEN].size(); i++) {
-      balance += queenBonus(locations[Piece::QUEEN][i], board, turn, endgame);
+    board.makeMove(moves[i], undo);
+    moveScore = -quiesce(t, Piece::opposite(color), ply+1, -beta, -alpha);
+    board.unmakeMove(moves[i], undo);
+
+    if(t.is_stopped) {
+      return 0;
     }
-    for(int i=0; i < locations[Piece::ROOK].size(); i++) {
-      balance += rookBonus(locations[Piece::ROOK][i], board, turn, endgame);
+
+    if(moveScore > bestScore) {
+      bestScore = moveScore;
     }
-    for(int i=0; i < locations[Piece::BISHOP].size(); i++) {
-      balance += bishopBonus(locations[Piece::BISHOP][i], board, turn, endgame);
+    if(bestScore > alpha) {
+      alpha = bestScore;
     }
-    for(int i=0; i < locations[Piece::KNIGHT].size(); i++) {
-      balance += knightBonus(locations[Piece::KNIGHT][i], board, turn, endgame);
+    if(alpha >= beta) {
+      break;
     }
-    for(int i=0; i < locations[Piece::PAWN].size(); i++) {
-      balance += pawnBonus(locations[Piece::PAWN][i], board, turn, endgame);
+  }
+
+  return bestScore;
+}
+
+// Gives every move in 'moves' a score in 'scores', higher meaning it is
+// tried earlier. See HASH_MOVE_SCORE and friends.
+void NicePlayer::scoreMoves(const SearchThread & t, Piece::Color color, const MoveList & moves,
+                            const Move & hashMove, int ply, int scores[])
+{
+  const Board & board = t.board;
+  bool hasKillers = ply < MAX_PLY;
+
+  for(int i=0; i < moves.size(); i++) {
+    const Move & m = moves[i];
+    Piece::Type victim = (m.kind() == Move::ENPASSANT) ? Piece::PAWN : board.typeAt(m.to());
+
+    if(m == hashMove) {
+      scores[i] = HASH_MOVE_SCORE;
+    } else if(victim != Piece::NOTYPE || m.promotion() == Piece::QUEEN) {
+      Piece::Type attacker = board.typeAt(m.from());
+      int exchange = 0;
+
+      // Only promotions and captures by a piece worth more than its
+      // victim can lose material, the exchange is worked out just for those
+      if(m.kind() == Move::PROMOTION ||
+         Board::getPieceValue(victim) < Board::getPieceValue(attacker)) {
+        exchange = board.see(m);
+      }
+
+      if(exchange < 0) {
+        // Losing captures go after the quiet moves
+        scores[i] = exchange;
+      } else if(victim == Piece::NOTYPE) {
+        scores[i] = CAPTURE_SCORE + 16 * MVV_LVA_VALUE[Piece::QUEEN] - MVV_LVA_VALUE[Piece::PAWN];
+      } else {
+        scores[i] = CAPTURE_SCORE + 16 * MVV_LVA_VALUE[victim] - MVV_LVA_VALUE[attacker];
+      }
+    } else if(m.kind() == Move::PROMOTION) {
+      // Underpromotions hardly ever matter
+      scores[i] = -1;
+    } else if(hasKillers && m == t.killers[ply][0]) {
+      scores[i] = KILLER_SCORE + 1;
+    } else if(hasKillers && m == t.killers[ply][1]) {
+      scores[i] = KILLER_SCORE;
+    } else {
+      scores[i] = t.history_table[color][m.from()][m.to()];
     }
-    for(int i=0; i < locations[Piece::KING].size(); i++) {
-      balance += kingBonus(locations[Piece::KING][i], board, turn, endgame);
+  }
+}
+
+// Moves the best scored move among the ones from 'i' on to 'i'. Sorting
+// the list this way costs nothing for the moves a cutoff leaves untried.
+void NicePlayer::pickMove(MoveList & moves, int scores[], int i)
+{
+  int best = i;
+
+  for(int j=i+1; j < moves.size(); j++) {
+    if(scores[j] > scores[best]) {
+      best = j;
     }
+  }
+
+  if(best != i) {
+    Move m = moves[i];
+    moves[i] = moves[best];
+    moves[best] = m;
 
-    return balance;
+    int s = scores[i];
+    scores[i] = scores[best];
+    scores[best] = s;
+  }
 }
 
-// Queen Bonuses are finished, queens get bonuses for being near an opposing king.
-int NicePlayer::queenBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
-  if (!endgame) {
-    return 0;
+// Remembers a quiet move that caused a beta cutoff as a killer move of
+// this ply and gives it history credit, more for deeper searches.
+void NicePlayer::updateOrdering(SearchThread & t, Piece::Color color, const Move & move, int depth, int ply)
+{
+  if(t.board.typeAt(move.to()) != Piece::NOTYPE || move.kind() == Move::ENPASSANT ||
+     move.kind() == Move::PROMOTION) {
+    return;
   }
 
-  Piece * p = board.getPiece(bp);
-  int bonus = 0;
-  BoardMove dist;
-    
-  if (p->color() == Piece::WHITE) {
-    dist = BoardMove(bp, board.getKing(Piece::BLACK), p);
+  if(ply < MAX_PLY && t.killers[ply][0] != move) {
+    t.killers[ply][1] = t.killers[ply][0];
+    t.killers[ply][0] = move;
   }
-  else {
-    dist = BoardMove(bp, board.getKing(Piece::WHITE), p);
+
+  int & h = t.history_table[color][move.from()][move.to()];
+  h += (depth + 1) * (depth + 1);
+
+  // Keep the history below the killers, older credit fading
+  if(h >= HISTORY_LIMIT) {
+    for(int c = 0; c <= Piece::LAST_COLOR; c++) {
+      for(int from = 0; from < 64; from++) {
+        for(int to = 0; to < 64; to++) {
+          t.history_table[c][from][to] /= 2;
+        }
+      }
+    }
   }
+}
 
-  bonus = -2*abs(dist.fileDiff()+dist.rankDiff());
+// Returns true if the position 'hash' already occured in the game or
+// on the path of the search. Once is enough to call it a draw, since
+// whatever was played from there can be played again.
+bool NicePlayer::isRepetition(const SearchThread & t, unsigned long long hash) const
+{
+  for(int i = (int)t.history.size() - 2; i >= 0; i -= 2) {
+    if(t.history[i] == hash) {
+      return true;
+    }
+  }
 
-  return (turn == p->color()) ? bonus : -bonus;
+  return false;
 }
 
-int NicePlayer::rookBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
-  int bonus = 0;
+// Material and piece-square values come ready made from the board, only
+// the terms that depend on several pieces are computed here. Mates are
+// left to the search. Endings the bitbase knows are scored far above or
+// below everything else when won or lost, so that the search heads for
+// them, the usual terms still telling the won positions apart.
+int NicePlayer::evaluateBoard(const Board & board, Piece::Color turn, PawnHashTable & pawnTable)
+{
+  Bitbase::Result result = m_bitbase.probe(board);
+  if(result == Bitbase::DRAW) {
+    return 0;
+  }
 
-  // Rooks get a bonus of 0 points if blocked, or up to 20 points if
-  // attacking 12 squares or more.
-  unsigned long long rookAttacks = Board::rankAttacks[bp.hash()][board.getRankState(bp)] ||
-                                   Board::fileAttacks[bp.hash()][board.getFileState(bp)];
-  int numAttacked = numAttackedSquares(rookAttacks);
-  bonus += (numAttacked < 12) ? 2*numAttacked-4 : 20;
+  bool endgame = board.getMaterial() < ENDGAME_MATERIAL;
+  int score = board.getPsqScore(endgame);
 
-  return bonus;
+  score += pawnBonus(board, pawnTable);
+  score += mobilityBonus(board, Piece::WHITE) - mobilityBonus(board, Piece::BLACK);
+  score += rookBonus(board, Piece::WHITE) - rookBonus(board, Piece::BLACK);
+  score += queenBonus(board, Piece::WHITE, endgame) - queenBonus(board, Piece::BLACK, endgame);
+  score += kingBonus(board, Piece::WHITE, endgame) - kingBonus(board, Piece::BLACK, endgame);
+
+  if(turn == Piece::BLACK) {
+    score = -score;
+  }
+
+  // The bitbase is seen from the side to move, which 'turn' is
+  if(result == Bitbase::WIN) {
+    score += BITBASE_WIN_SCORE;
+  } else if(result == Bitbase::LOSS) {
+    score -= BITBASE_WIN_SCORE;
+  }
+
+  return score;
 }
 
+// Returns the pawn structure score from white's point of view, from the
+// pawn hash table if the same pawns were seen before.
+int NicePlayer::pawnBonus(const Board & board, PawnHashTable & pawnTable)
+{
+  unsigned long long key = board.getPawnHash();
+  int score;
 
-int NicePlayer::bishopBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
-  Piece::Color color = board.getPiece(bp)->color();
-  int bonus = m_bishop[bp.hash()];
+  if(!pawnTable.probe(key, score)) {
+    score = pawnStructure(board, Piece::WHITE) - pawnStructure(board, Piece::BLACK);
+    pawnTable.store(key, score);
+  }
 
-  return (turn == color) ? bonus: -bonus;
+  return score;
 }
 
+// Scores the pawns of color 'c' with whole board fills instead of looking
+// at each pawn's surroundings. Isolated pawns lose more towards the
+// center, passed pawns gain more the further they are.
+int NicePlayer::pawnStructure(const Board & board, Piece::Color c)
+{
+  static const int isolatedPenalty[Board::BOARDSIZE] = { 12, 14, 16, 20, 20, 16, 14, 12 };
+  static const int passedBonus[Board::BOARDSIZE] = { 0, 5, 10, 20, 35, 60, 100, 0 };
+  const int doubledPenalty = 12;
+  const int backwardPenalty = 8;
 
-int NicePlayer::knightBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
-  Piece::Color color = board.getPiece(bp)->color();
-  int bonus = m_knight[bp.hash()];
+  bool white = (c == Piece::WHITE);
+  unsigned long long own = board.m_pieces[Piece::PAWN] & board.m_color[c];
+  unsigned long long enemy = board.m_pieces[Piece::PAWN] & board.m_color[Piece::opposite(c)];
+  int bonus = 0;
 
-  bool drivenBonus = false;
+  // One rank and all ranks ahead of the pawns of 'c', and behind them
+  unsigned long long (*ahead)(unsigned long long) = white ? BitBoard::north : BitBoard::south;
+  unsigned long long (*behind)(unsigned long long) = white ? BitBoard::south : BitBoard::north;
+  unsigned long long (*aheadFill)(unsigned long long) = white ? BitBoard::northFill : BitBoard::southFill;
+  unsigned long long (*behindFill)(unsigned long long) = white ? BitBoard::southFill : BitBoard::northFill;
 
-  // Knights are given a bonus for being within 2 squares of each enemy piece.
-  
+  // Squares ahead of the pawns of each side, seen from that side
+  unsigned long long ownFront = aheadFill(ahead(own));
+  unsigned long long enemyFront = behindFill(behind(enemy));
+  unsigned long long ownFiles = BitBoard::fileFill(own);
 
-  return (turn == color) ? bonus : -bonus;
-}
+  // Isolated: no own pawn on a neighbouring file
+  unsigned long long isolated = own & ~(BitBoard::east(ownFiles) | BitBoard::west(ownFiles));
 
-int NicePlayer::pawnBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
-  Piece::Color color = board.getPiece(bp)->color();
-  int bonus = (color == Piece::WHITE) ? m_wpawn[bp.hash()] : m_bpawn[bp.hash()];
+  // Doubled: another own pawn ahead on the same file
+  unsigned long long doubled = own & behindFill(behind(own));
 
-  if(isIsolatedPawn(bp, board)) {
-    char file = bp.filec();
-    if(file == 'a' || file == 'h') {
-        bonus -= 12;
-    } else if (file == 'b' || file == 'g') {
-        bonus -= 14;
-    } else if (file == 'c' || file == 'f') {
-        bonus -= 16;
-    } else if (file == 'd' || file == 'e') {
-        bonus -= 20;
-    }
+  // Passed: no enemy pawn ahead on the same or a neighbouring file
+  unsigned long long passed = own & ~doubled &
+    ~(enemyFront | BitBoard::east(enemyFront) | BitBoard::west(enemyFront));
+
+  // Backward: the square ahead is guarded by an enemy pawn and no own
+  // pawn will ever guard it
+  unsigned long long stops = ahead(own);
+  unsigned long long enemyAttacks = BitBoard::east(behind(enemy)) | BitBoard::west(behind(enemy));
+  unsigned long long ownAttackSpan = BitBoard::east(ownFront) | BitBoard::west(ownFront);
+  unsigned long long backward = behind(stops & enemyAttacks & ~ownAttackSpan) & ~isolated;
+
+  for(int sq : BitBoard(isolated)) {
+    bonus -= isolatedPenalty[sq % Board::BOARDSIZE];
   }
-  /*
-  if(isDoubledPawn(bp, board)) {
+
+  for(int sq : BitBoard(passed)) {
+    bonus += passedBonus[white ? sq / Board::BOARDSIZE : Board::BOARDSIZE - 1 - sq / Board::BOARDSIZE];
   }
-  */
-  return (turn == color) ? bonus : -bonus;
+
+  bonus -= doubledPenalty * BitBoard::popcount(doubled);
+  bonus -= backwardPenalty * BitBoard::popcount(backward);
+
+  return bonus;
 }
 
-int NicePlayer::kingBonus(const BoardPosition & bp, const Board & board, Piece::Color turn, bool endgame) {
-  Piece::Color color = board.getPiece(bp)->color();
+// Knights, bishops and queens gain points for every square they attack
+// that no piece of their own stands on, and lose points below the number
+// of squares they attack from an ordinary square.
+int NicePlayer::mobilityBonus(const Board & board, Piece::Color c)
+{
+  unsigned long long own = board.m_color[c];
+  unsigned long long occupied = board.getOccupied();
   int bonus = 0;
 
-  // Count all pieces attacking the king
-  unsigned long long attacked = board.isAttacked(bp, color);
-  for(int i=0; i < 64; i++) {
-    bonus -= 25*((attacked >> i) & 1);
+  for(int sq : BitBoard(board.m_pieces[Piece::KNIGHT] & own)) {
+    bonus += 4 * (BitBoard::popcount(Board::knightAttacks[sq] & ~own) - 4);
   }
-  
-  if(endgame) {
-    bonus = m_end_king[bp.hash()];
-  } else {
-    bonus = (color == Piece::WHITE) ? m_wking[bp.hash()] : m_bking[bp.hash()];
+  for(int sq : BitBoard(board.m_pieces[Piece::BISHOP] & own)) {
+    bonus += 3 * (BitBoard::popcount(Board::bishopAttacks(sq, occupied) & ~own) - 6);
   }
-  
-  return (turn == color) ? bonus : -bonus;
+  for(int sq : BitBoard(board.m_pieces[Piece::QUEEN] & own)) {
+    bonus += BitBoard::popcount(Board::queenAttacks(sq, occupied) & ~own) - 12;
+  }
+
+  return bonus;
 }
 
-int NicePlayer::numAttackedSquares(const unsigned long long & pieceAttacks)
+// Rooks get a bonus of 0 points if blocked, or up to 20 points if
+// attacking 12 squares or more.
+int NicePlayer::rookBonus(const Board & board, Piece::Color c)
 {
-  int numSquares = 0;
-  for (int i = 0; i < 64; i++) {
-    if (pieceAttacks && (1LL << i)) {
-      numSquares++;
-    }
+  unsigned long long rooks = board.m_pieces[Piece::ROOK] & board.m_color[c];
+  unsigned long long occupied = board.getOccupied();
+  int bonus = 0;
+
+  for(int sq : BitBoard(rooks)) {
+    int numAttacked = BitBoard::popcount(Board::rookAttacks(sq, occupied));
+    bonus += (numAttacked < 12) ? 2*numAttacked-4 : 20;
   }
-  return numSquares;
+
+  return bonus;
 }
 
-bool NicePlayer::isIsolatedPawn(const BoardPosition & bp, const Board & board)
+// In the end game queens get bonuses for being near the opposing king.
+int NicePlayer::queenBonus(const Board & board, Piece::Color c, bool endgame)
 {
-  Piece::Color c = board.getPiece(bp)->color();
-  unsigned long long mask = board.m_color[c] & board.m_pieces[Piece::PAWN];
-
-  BoardPosition test = bp.E();
-  if(test.isValid() && (mask & maskFile(test))) {
-    return false;
+  if(!endgame) {
+    return 0;
   }
 
-  test = bp.W();
-  if(test.isValid() && (mask & maskFile(test))) {
-    return false;
+  unsigned long long queens = board.m_pieces[Piece::QUEEN] & board.m_color[c];
+  int king = board.getKing(Piece::opposite(c)).hash();
+  int bonus = 0;
+
+  for(int sq : BitBoard(queens)) {
+    bonus -= 2*(abs(sq % Board::BOARDSIZE - king % Board::BOARDSIZE) +
+                abs(sq / Board::BOARDSIZE - king / Board::BOARDSIZE));
   }
 
-  return true;
+  return bonus;
 }
 
-bool NicePlayer::isDoubledPawn(const BoardPosition & bp, const Board & board)
+// Before the end game a king is safer behind the pawns right in front
+// of it.
+int NicePlayer::kingBonus(const Board & board, Piece::Color c, bool endgame)
 {
-  return false;
-}
+  if(endgame) {
+    return 0;
+  }
 
-// Positional Bonuses
-int NicePlayer::m_bishop[64] = {
-  -5,-5,-5,-5,-5,-5,-5,-5,
-  -5,10,5,10,10,5,10,-5,
-  -5,5,3,12,12,3,5,-5,
-  -5,3,12,3,3,12,3,-5,
-  -5,3,12,3,3,12,3,-5,
-  -5,5,3,12,12,3,5,-5,
-  -5,10,5,10,10,5,10,-5,
-  -5,-5,-5,-5,-5,-5,-5,-5 };
-
-int NicePlayer::m_knight[64] = {
-  -10,-5,-5,-5,-5,-5,-5,-10,
-  -5,0,0,3,3,0,0,-5,
-  -5,0,5,5,5,5,0,-5,
-  -5,0,5,10,10,5,0,-5,
-  -5,0,5,10,10,5,0,-5,
-  -5,0,5,5,5,5,0,-5,
-  -5,0,0,3,3,0,0,-5,
-  -10,-5,-5,-5,-5,-5,-5,-10 };
-
-int NicePlayer::m_wpawn[64] = {
-  0,0,0,0,0,0,0,0,
-  0,0,0,-5,-5,0,0,0,
-  1,2,3,4,4,3,2,1,
-  2,4,6,8,8,6,4,2,
-  3,6,9,12,12,9,6,3,
-  4,8,12,16,16,12,8,4,
-  5,10,15,20,20,15,10,5,
-  0,0,0,0,0,0,0,0 };
-
-int NicePlayer::m_bpawn[64] = {
-  0,0,0,0,0,0,0,0,
-  5,10,15,20,20,15,10,5,
-  4,8,12,16,16,12,8,4,
-  3,6,9,12,12,9,6,3,
-  2,4,6,8,8,6,4,2,
-  1,2,3,4,4,3,2,1,
-  0,0,0,-5,-5,0,0,0,
-  0,0,0,0,0,0,0,0 };
-
-int NicePlayer::m_wking[64] = {
-  2,10,4,0,0,7,10,2,
-  -3,-3,-5,-5,-5,-5,-3,-3,
-  -5,-5,-8,-8,-8,-8,-5,-5,
-  -8,-8,-13,-13,-13,-13,-8,-8,
-  -13,-13,-21,-21,-21,-21,-13,-13,
-  -21,-21,-34,-34,-34,-34,-21,-21,
-  -34,-34,-55,-55,-55,-55,-34,-34,
-  -55,-55,-89,-89,-89,-89,-55,-55};
-
-int NicePlayer::m_bking[64] = {
-  -55,-55,-89,-89,-89,-89,-55,-55,
-  -34,-34,-55,-55,-55,-55,-34,-34,
-  -21,-21,-34,-34,-34,-34,-21,-21,
-  -13,-13,-21,-21,-21,-21,-13,-13,
-  -8,-8,-13,-13,-13,-13,-8,-8,
-  -5,-5,-8,-8,-8,-8,-5,-5,
-  -3,-3,-5,-5,-5,-5,-3,-3,
-  2,10,4,0,0,7,10,2};
-
-int NicePlayer::m_end_king[64] = {
-  -5,-3,-1,0,0,-1,-3,-5,
-  -3,5,5,5,5,5,5,-3,
-  -1,5,10,10,10,10,5,-1,
-  0,5,10,15,15,10,5,0,
-  0,5,10,15,15,10,5,0,
-  -1,5,10,10,10,10,5,-1,
-  -3,5,5,5,5,5,5,-3,
-  -5,-3,-1,0,0,-1,-3,-5};
+  int king = board.getKing(c).hash();
+  unsigned long long ahead = (c == Piece::WHITE) ? BitBoard::north(1ULL << king)
+                                                 : BitBoard::south(1ULL << king);
+  unsigned long long shelter = Board::pawnAttacks[c][king] | ahead;
+
+  return 8 * BitBoard::popcount(shelter & board.m_pieces[Piece::PAWN] & board.m_color[c]);
+}
 
 // end of file niceplayer.cpp
 
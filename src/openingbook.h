@@ -0,0 +1,98 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : openingbook.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef OPENINGBOOK_H
+#define OPENINGBOOK_H
+
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+/**
+ * An opening book in the Polyglot .bin format. The file is a list of
+ * 16 byte entries sorted by position key, each holding a move of that
+ * position and a weight, all numbers big endian. The file is memory
+ * mapped and binary searched in place, so opening even a large book
+ * reads nothing but the entries looked at.
+ *
+ * Position keys are computed the way Polyglot does, with its Random64
+ * table, so books made by other Polyglot tools are found and books made
+ * by bookbuild can be read by them.
+ */
+class OpeningBook {
+ public:
+  /** One move of one position, as stored in the file. */
+  struct Entry {
+    unsigned long long key;
+    unsigned short move;
+    unsigned short weight;
+    unsigned int learn;
+  };
+
+  OpeningBook();
+  ~OpeningBook();
+
+  /**
+   * Maps the book 'filename', closing the book opened before. Returns
+   * false if the file can not be read or is no book.
+   */
+  bool open(const std::string & filename);
+
+  /** Unmaps the book. */
+  void close();
+
+  bool isOpen() const
+    { return m_data != NULL; }
+
+  /** Returns the name of the open book, empty if none is. */
+  const std::string & getFilename() const
+    { return m_filename; }
+
+  /** Returns the number of entries of the open book. */
+  unsigned long getSize() const
+    { return m_count; }
+
+  /**
+   * Picks a move for the side to move of 'board' at random, each legal
+   * book move having a chance in proportion to its weight. Returns false
+   * if the book has no move for the position.
+   */
+  bool probe(const Board & board, Move & move) const;
+
+  /** Returns the Polyglot key of the position of 'board'. */
+  static unsigned long long key(const Board & board);
+
+  /** Returns the move 'm' in the Polyglot move encoding. */
+  static unsigned short encodeMove(const Move & m);
+
+  /**
+   * Sorts 'entries' by key and writes them to the book 'filename'.
+   * Returns false if the file can not be written.
+   */
+  static bool write(const std::string & filename, std::vector<Entry> & entries);
+
+ private:
+  /** Returns entry 'i' of the mapped file. */
+  Entry entry(unsigned long i) const;
+
+  /** Returns the index of the first entry not below 'key'. */
+  unsigned long lowerBound(unsigned long long key) const;
+
+  const unsigned char * m_data;
+  unsigned long m_length;
+  unsigned long m_count;
+  std::string m_filename;
+#ifdef WIN32
+  std::vector<unsigned char> m_buffer;
+#endif
+};
+
+#endif
+
+// End of file openingbook.h
@@ -8,6 +8,8 @@
 
 #include "options.h"
 
+#include "SDL.h"
+
 Options* Options::m_instance = 0;
 
 Options* Options::getInstance()
@@ -34,6 +36,7 @@ Options::Options()
   ishighlightsquare = false;
   squarehighlightcolor = 0xffbf00;
   ishighlightpiece = false;
+  ishighlighthanging = false;
   board = GRANITE;
   pieces = BASIC;
   player1type = "Human";
@@ -55,6 +58,23 @@ Options::Options()
   texturedirectory = "";
   fontfilename = FONT_FILENAME;
   mincomputermovetimems = 1000;
+  hashsizemb = 16;
+  pawnhashsizekb = 256;
+
+  // Leave one core for drawing the board
+  searchthreads = SDL_GetCPUCount() - 1;
+  if(searchthreads < 0) {
+    searchthreads = 0;
+  }
+
+  isnullmove = true;
+  islatemovereduction = true;
+  isfutility = true;
+  isponder = true;
+  issearchstats = false;
+  benchmarkdepth = 0;
+  bookfilename = "";
+  bitbasefilename = "nicechess.bitbase";
 
   // Initialize the enum maps
   m_boardTypeString[GRANITE] = "Granite";
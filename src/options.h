@@ -35,6 +35,7 @@ class Options {
   bool fullscreen, maximized;
   bool reflections, shadows;
   bool animations, historyarrows, ishighlightsquare, ishighlightpiece;
+  bool ishighlighthanging;
   BoardType board;
   PiecesType pieces;
   std::string player1type, player2type;
@@ -60,6 +61,15 @@ class Options {
   std::string whitesquareimagefilename;
   std::string blacksquareimagefilename;
   int mincomputermovetimems;
+  int hashsizemb;
+  int pawnhashsizekb;
+  int searchthreads;
+  bool isnullmove, islatemovereduction, isfutility;
+  bool isponder;
+  bool issearchstats;
+  int benchmarkdepth;
+  std::string bookfilename;
+  std::string bitbasefilename;
   std::string modeldirectory;
   std::string texturedirectory;
   std::string fontfilename;
@@ -0,0 +1,42 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : pawnhashtable.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include "pawnhashtable.h"
+
+PawnHashTable::PawnHashTable()
+  : m_mask(0), m_hits(0), m_misses(0)
+{
+  resize(1);
+}
+
+void PawnHashTable::resize(int kb)
+{
+  unsigned long long count = 1;
+  unsigned long long bytes = (unsigned long long)(kb < 1 ? 1 : kb) << 10;
+
+  while(2 * count * sizeof(Entry) <= bytes) {
+    count *= 2;
+  }
+
+  m_entries.assign(count, Entry());
+  m_mask = count - 1;
+  clear();
+}
+
+void PawnHashTable::clear()
+{
+  for(unsigned long long i = 0; i < m_entries.size(); i++) {
+    m_entries[i].key = 0;
+    m_entries[i].score = 0;
+    m_entries[i].is_used = false;
+  }
+
+  clearStats();
+}
+
+// End of file pawnhashtable.cpp
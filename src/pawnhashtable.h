@@ -0,0 +1,90 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : pawnhashtable.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef PAWNHASHTABLE_H
+#define PAWNHASHTABLE_H
+
+#include <vector>
+
+/**
+ * A cache of pawn structure scores, keyed on Board::getPawnHash(). The
+ * pawns change with few moves, so most positions of a search find
+ * their score here. Each search thread has a table of its own, so it
+ * needs no locking.
+ */
+class PawnHashTable {
+ public:
+  /** Creates an empty table, see resize. */
+  PawnHashTable();
+
+  /**
+   * Reallocates the table to use at most 'kb' kilobytes and clears it.
+   * The number of entries is rounded down to a power of two.
+   */
+  void resize(int kb);
+
+  /** Forgets all entries and resets the counters. */
+  void clear();
+
+  /** Resets the hit and miss counters. */
+  void clearStats()
+    { m_hits = 0; m_misses = 0; }
+
+  /**
+   * Looks up the pawn structure 'key'. Returns true and sets 'score' if
+   * it is in the table.
+   */
+  bool probe(unsigned long long key, int & score)
+  {
+    const Entry & e = m_entries[key & m_mask];
+    if(e.key == key && e.is_used) {
+      m_hits++;
+      score = e.score;
+      return true;
+    }
+    m_misses++;
+    return false;
+  }
+
+  /** Stores the score of the pawn structure 'key'. */
+  void store(unsigned long long key, int score)
+  {
+    Entry & e = m_entries[key & m_mask];
+    e.key = key;
+    e.score = score;
+    e.is_used = true;
+  }
+
+  /** Returns the number of probes that found their pawn structure. */
+  unsigned long long getHits() const
+    { return m_hits; }
+
+  /** Returns the number of probes that did not. */
+  unsigned long long getMisses() const
+    { return m_misses; }
+
+  /** Returns the size of the table in bytes. */
+  unsigned long long getSize() const
+    { return m_entries.size() * sizeof(Entry); }
+
+ private:
+  struct Entry {
+    unsigned long long key;
+    int score;
+    bool is_used;
+  };
+
+  std::vector<Entry> m_entries;
+  unsigned long long m_mask;
+  unsigned long long m_hits;
+  unsigned long long m_misses;
+};
+
+#endif
+
+// End of file pawnhashtable.h
@@ -0,0 +1,167 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : perft.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "chessgamestate.h"
+
+using namespace std;
+
+static const string START_FEN =
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+/**
+ * Returns the move in coordinate notation, e.g. 'e2e4' or 'a7a8q'.
+ */
+static string moveString(const BoardMove & bm)
+{
+  string str;
+
+  str += bm.origin().filec();
+  str += '0' + bm.origin().rank();
+  str += bm.dest().filec();
+  str += '0' + bm.dest().rank();
+
+  switch (bm.getPromotion())
+  {
+    case Piece::ROOK:   { str += 'r'; break; }
+    case Piece::KNIGHT: { str += 'n'; break; }
+    case Piece::BISHOP: { str += 'b'; break; }
+    case Piece::QUEEN:  { str += 'q'; break; }
+    default: { break; }
+  }
+
+  return str;
+}
+
+/**
+ * Counts the leaf nodes of the legal move tree 'depth' plies deep.
+ */
+static unsigned long long perft(Board & board, Piece::Color color, int depth)
+{
+  if (depth == 0) {
+    return 1;
+  }
+
+  MoveList moves;
+  board.generateMoves(color, moves);
+
+  if (depth == 1) {
+    return moves.size();
+  }
+
+  unsigned long long nodes = 0;
+  UndoInfo undo;
+
+  for (int i = 0; i < moves.size(); i++) {
+    board.makeMove(moves[i], undo);
+    nodes += perft(board, Piece::opposite(color), depth-1);
+    board.unmakeMove(moves[i], undo);
+  }
+
+  return nodes;
+}
+
+static void printUsage()
+{
+  cerr << "Usage: perft [options] DEPTH [FEN]" << endl;
+  cerr << " -h   Print this help screen." << endl;
+  cerr << " -d   Print the node count of each root move (divide)." << endl;
+  cerr << endl;
+  cerr << "FEN defaults to the starting position." << endl;
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  bool divide = false;
+  int depth = -1;
+  string fen;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "-h") {
+      printUsage();
+    } else if (arg == "-d") {
+      divide = true;
+    } else if (depth < 0) {
+      depth = atoi(arg.c_str());
+    } else {
+      // The FEN may be passed unquoted as several arguments
+      fen += (fen.empty() ? "" : " ") + arg;
+    }
+  }
+
+  if (depth < 1) {
+    printUsage();
+  }
+
+  if (fen.empty()) {
+    fen = START_FEN;
+  }
+
+  Board::init();
+
+  ChessGameState cgs;
+
+  if (!cgs.setFen(fen)) {
+    cerr << "Invalid FEN: " << fen << endl;
+    return 1;
+  }
+
+  Board board = cgs.getBoard();
+  Piece::Color color = cgs.getTurn();
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  unsigned long long nodes = 0;
+
+  if (divide) {
+    MoveList moves;
+    UndoInfo undo;
+
+    board.generateMoves(color, moves);
+
+    for (int i = 0; i < moves.size(); i++) {
+      BoardMove bm = board.toBoardMove(moves[i]);
+
+      board.makeMove(moves[i], undo);
+      unsigned long long count = perft(board, Piece::opposite(color), depth-1);
+      board.unmakeMove(moves[i], undo);
+
+      cout << moveString(bm) << ": " << count << endl;
+      nodes += count;
+    }
+
+    cout << endl;
+    cout << "Moves: " << moves.size() << endl;
+  } else {
+    nodes = perft(board, color, depth);
+  }
+
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  long long us = chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+  if (us < 1) {
+    us = 1;
+  }
+
+  cout << "Nodes: " << nodes << endl;
+  cout << "Time: " << us / 1000 << " ms" << endl;
+  cout << "Nodes/second: " << (unsigned long long)(nodes * 1000000.0 / us) << endl;
+
+  return 0;
+}
+
+// End of file perft.cpp
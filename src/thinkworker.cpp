@@ -0,0 +1,154 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : thinkworker.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include "chessgame.h"
+#include "chessplayer.h"
+#include "options.h"
+#include "thinkworker.h"
+
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+ThinkWorker::ThinkWorker()
+  : m_thread(NULL), m_head(0), m_tail(0), m_posted(0), m_waited(0)
+{
+  m_queued = SDL_CreateSemaphore(0);
+  m_done = SDL_CreateSemaphore(0);
+}
+
+ThinkWorker::~ThinkWorker()
+{
+  stop();
+  SDL_DestroySemaphore(m_queued);
+  SDL_DestroySemaphore(m_done);
+}
+
+bool ThinkWorker::start()
+{
+  if(m_thread) {
+    return true;
+  }
+
+  m_thread = SDL_CreateThread(run, "think", this);
+  if(m_thread == NULL) {
+    cerr << "Unable to create think thread: " << SDL_GetError() << endl;
+    return false;
+  }
+  return true;
+}
+
+void ThinkWorker::stop()
+{
+  if(!m_thread) {
+    return;
+  }
+
+  Job job;
+  job.type = QUIT;
+  job.game = NULL;
+  while(!post(job)) {
+    wait();
+  }
+  SDL_WaitThread(m_thread, NULL);
+  m_thread = NULL;
+
+  // Every job before the quit one is done by now
+  wait();
+}
+
+bool ThinkWorker::post(const Job & job)
+{
+  unsigned int head = m_head.load(std::memory_order_relaxed);
+
+  if(!m_thread || head - m_tail.load(std::memory_order_acquire) >= QUEUE_SIZE) {
+    return false;
+  }
+
+  m_jobs[head % QUEUE_SIZE] = job;
+  m_head.store(head + 1, std::memory_order_release);
+  if(job.type != QUIT) {
+    m_posted++;
+  }
+  SDL_SemPost(m_queued);
+  return true;
+}
+
+void ThinkWorker::wait()
+{
+  while(m_waited != m_posted) {
+    SDL_SemWait(m_done);
+    m_waited++;
+  }
+}
+
+int ThinkWorker::run(void * data)
+{
+  ThinkWorker * worker = (ThinkWorker *)data;
+
+  for(;;) {
+    SDL_SemWait(worker->m_queued);
+
+    unsigned int tail = worker->m_tail.load(std::memory_order_relaxed);
+    if(tail == worker->m_head.load(std::memory_order_acquire)) {
+      continue;
+    }
+    Job job = worker->m_jobs[tail % QUEUE_SIZE];
+    worker->m_tail.store(tail + 1, std::memory_order_release);
+
+    switch(job.type) {
+      case THINK:
+        worker->think(job.game);
+        break;
+      case QUIT:
+        return 0;
+    }
+    SDL_SemPost(worker->m_done);
+  }
+}
+
+// Lets the player to move find its move, and tells the main thread about
+// it unless it was told to stop
+void ThinkWorker::think(ChessGame * game)
+{
+  int starttimems;
+  int endtimems;
+
+  Options* opts = Options::getInstance();
+
+  starttimems = SDL_GetTicks();
+
+  // Give the player time to think
+  game->getCurrentPlayer()->setStopThinking(false);
+  game->getCurrentPlayer()->think(game->getState());
+
+  if (game->getCurrentPlayer()->isStopThinking())
+  {
+    return;
+  }
+
+  endtimems = SDL_GetTicks();
+
+  if (endtimems - starttimems < opts->mincomputermovetimems)
+  {
+    SDL_Delay(opts->mincomputermovetimems - (endtimems - starttimems));
+  }
+
+  game->getCurrentPlayer()->setThinking(false);
+
+  // Finished thinking, let the main thread know
+  SDL_Event thinkevent;
+  thinkevent.type = SDL_USEREVENT;
+  thinkevent.user.code = 0;
+  thinkevent.user.data1 = game->getCurrentPlayer();
+  thinkevent.user.data2 = NULL;
+  SDL_PushEvent(&thinkevent);
+}
+
+// End of file thinkworker.cpp
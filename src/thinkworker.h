@@ -0,0 +1,85 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : thinkworker.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef THINKWORKER_H
+#define THINKWORKER_H
+
+#include <atomic>
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+class ChessGame;
+
+/**
+ * One thread that lives as long as the game and runs the thinking of the
+ * players, one job at a time, instead of a new thread for every move.
+ *
+ * Jobs go through a small ring that only the main thread writes and only
+ * the worker reads, so it needs no lock. A semaphore wakes the worker up
+ * when a job is queued and another one tells the main thread that a job
+ * is done. A finished think job is still announced with a SDL_USEREVENT
+ * of code 0 that carries the player.
+ */
+class ThinkWorker {
+ public:
+  enum JobType { THINK, QUIT };
+
+  struct Job {
+    JobType type;
+    ChessGame * game;
+  };
+
+  ThinkWorker();
+  ~ThinkWorker();
+
+  /** Starts the thread. Returns false if it can not be created. */
+  bool start();
+
+  /** Lets the jobs queued so far finish and ends the thread. */
+  void stop();
+
+  bool isRunning() const
+    { return m_thread != NULL; }
+
+  /**
+   * Queues 'job'. Only the main thread may call this. Returns false if the
+   * thread is not running or the queue is full.
+   */
+  bool post(const Job & job);
+
+  /** Whether a job was posted that has not been waited for yet. */
+  bool isBusy() const
+    { return m_waited != m_posted; }
+
+  /** Blocks until every job posted so far is done. */
+  void wait();
+
+ private:
+  const static unsigned int QUEUE_SIZE = 8;
+
+  static int run(void * data);
+  void think(ChessGame * game);
+
+  SDL_Thread * m_thread;
+  SDL_sem * m_queued;
+  SDL_sem * m_done;
+
+  Job m_jobs[QUEUE_SIZE];
+  // Jobs ever written by the main thread and ever read by the worker
+  std::atomic<unsigned int> m_head;
+  std::atomic<unsigned int> m_tail;
+
+  // Jobs posted and waited for, only used by the main thread
+  unsigned int m_posted;
+  unsigned int m_waited;
+};
+
+#endif
+
+// End of file thinkworker.h
@@ -0,0 +1,170 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : transpositiontable.cpp
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#include "transpositiontable.h"
+
+using std::memory_order_relaxed;
+
+TranspositionTable::TranspositionTable()
+  : m_buckets(NULL), m_mask(0), m_age(0)
+{
+}
+
+TranspositionTable::~TranspositionTable()
+{
+  delete [] m_buckets;
+}
+
+void TranspositionTable::resize(int mb)
+{
+  unsigned long long count = 1;
+  unsigned long long bytes = (unsigned long long)(mb < 1 ? 1 : mb) << 20;
+
+  while(2 * count * sizeof(Bucket) <= bytes) {
+    count *= 2;
+  }
+
+  delete [] m_buckets;
+  m_buckets = new Bucket[count];
+  m_mask = count - 1;
+  clear();
+}
+
+void TranspositionTable::clear()
+{
+  for(unsigned long long i = 0; m_buckets && i <= m_mask; i++) {
+    for(int j = 0; j < BUCKETSIZE; j++) {
+      m_buckets[i].slots[j].key.store(0, memory_order_relaxed);
+      m_buckets[i].slots[j].data.store(0, memory_order_relaxed);
+    }
+  }
+
+  m_age = 0;
+}
+
+unsigned long long TranspositionTable::pack(const TTEntry & entry)
+{
+  return (unsigned long long)(unsigned int)entry.score |
+         ((unsigned long long)entry.move << 32) |
+         ((unsigned long long)(unsigned char)entry.depth << 48) |
+         ((unsigned long long)entry.bound_age << 56);
+}
+
+TTEntry TranspositionTable::unpack(unsigned long long data)
+{
+  TTEntry entry;
+
+  entry.score = (int)(unsigned int)data;
+  entry.move = (unsigned short)(data >> 32);
+  entry.depth = (signed char)(data >> 48);
+  entry.bound_age = (unsigned char)(data >> 56);
+
+  return entry;
+}
+
+bool TranspositionTable::probe(unsigned long long key, TTEntry & entry, TTStats & stats)
+{
+  if(!m_buckets) {
+    return false;
+  }
+
+  Slot * slots = m_buckets[key & m_mask].slots;
+
+  for(int i = 0; i < BUCKETSIZE; i++) {
+    unsigned long long data = slots[i].data.load(memory_order_relaxed);
+
+    if((slots[i].key.load(memory_order_relaxed) ^ data) == key && data) {
+      entry = unpack(data);
+      stats.hits++;
+
+      // Still useful, keep it from being replaced by this search
+      if(entry.age() != m_age) {
+        entry.bound_age = (m_age << 2) | entry.bound();
+        data = pack(entry);
+        slots[i].key.store(key ^ data, memory_order_relaxed);
+        slots[i].data.store(data, memory_order_relaxed);
+      }
+      return true;
+    }
+  }
+
+  stats.misses++;
+  return false;
+}
+
+void TranspositionTable::store(unsigned long long key, int depth, int score,
+                               TTEntry::Bound bound, const Move & move, TTStats & stats)
+{
+  if(!m_buckets) {
+    return;
+  }
+
+  Slot * slots = m_buckets[key & m_mask].slots;
+  Slot * replace = NULL;
+  TTEntry old = TTEntry();
+  int worst = 0;
+
+  for(int i = 0; i < BUCKETSIZE; i++) {
+    unsigned long long data = slots[i].data.load(memory_order_relaxed);
+    TTEntry entry = unpack(data);
+
+    if(!data || (slots[i].key.load(memory_order_relaxed) ^ data) == key) {
+      replace = &slots[i];
+      old = entry;
+      break;
+    }
+
+    // Older entries count as if they were eight plies shallower per search
+    int value = entry.depth - 8*((m_age - entry.age()) & 63);
+    if(!replace || value < worst) {
+      replace = &slots[i];
+      old = entry;
+      worst = value;
+    }
+  }
+
+  unsigned long long oldData = replace->data.load(memory_order_relaxed);
+  bool samePosition = oldData && (replace->key.load(memory_order_relaxed) ^ oldData) == key;
+
+  if(!samePosition && oldData && old.age() == m_age) {
+    stats.collisions++;
+  }
+
+  TTEntry entry;
+  entry.score = score;
+  entry.depth = depth;
+  entry.bound_age = (m_age << 2) | bound;
+  entry.move = move.raw();
+
+  // Keep the best move of an earlier search if this one found none
+  if(samePosition && move.isNull()) {
+    entry.move = old.move;
+  }
+
+  unsigned long long data = pack(entry);
+  replace->key.store(key ^ data, memory_order_relaxed);
+  replace->data.store(data, memory_order_relaxed);
+}
+
+int TranspositionTable::getUsage() const
+{
+  int used = 0;
+  int count = 0;
+
+  for(unsigned long long i = 0; m_buckets && i <= m_mask && i < 250; i++) {
+    for(int j = 0; j < BUCKETSIZE; j++) {
+      TTEntry entry = unpack(m_buckets[i].slots[j].data.load(memory_order_relaxed));
+      used += (entry.bound() != TTEntry::NONE && entry.age() == m_age);
+      count++;
+    }
+  }
+
+  return count ? used * 1000 / count : 0;
+}
+
+// End of file transpositiontable.cpp
@@ -0,0 +1,131 @@
+/***************************************************************************
+ * NiceChess
+ * https://github.com/BencsikRoland/nicechess
+ *
+ * File : transpositiontable.h
+ * Authors : Mike Cook, Joe Flint, Neil Pankey, Bencsik Roland
+ **************************************************************************/
+
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include <atomic>
+
+#include "move.h"
+
+/**
+ * What the search found out about one position.
+ */
+struct TTEntry {
+  /** How the score relates to the real value of the position. */
+  enum Bound { NONE = 0, UPPER = 1, LOWER = 2, EXACT = 3 };
+
+  int score;
+  unsigned short move;
+  signed char depth;
+  unsigned char bound_age;
+
+  Bound bound() const
+    { return Bound(bound_age & 3); }
+
+  int age() const
+    { return bound_age >> 2; }
+
+  Move bestMove() const
+    { return Move::fromRaw(move); }
+};
+
+/**
+ * Probe and store counters. Every search thread keeps its own so that
+ * counting does not make the threads fight over a cache line.
+ */
+struct TTStats {
+  TTStats() : hits(0), misses(0), collisions(0) {}
+
+  void add(const TTStats & s)
+    { hits += s.hits; misses += s.misses; collisions += s.collisions; }
+
+  /** Probes that found their position. */
+  unsigned long long hits;
+  /** Probes that did not find their position. */
+  unsigned long long misses;
+  /** Stores that overwrote another position from the same search. */
+  unsigned long long collisions;
+};
+
+/**
+ * A fixed size hash table of search results shared by all search
+ * threads without locking. Entries are grouped in buckets of one cache
+ * line. When a bucket is full the entry with the least depth is
+ * replaced, entries left over from earlier searches going first.
+ *
+ * Each slot stores the entry as one 64 bit word next to the position
+ * key xor'ed with that word. Two threads writing the same slot at once
+ * leave a slot whose key does not check out, which is read as a miss.
+ */
+class TranspositionTable {
+ public:
+  /** Creates an empty table, see resize. */
+  TranspositionTable();
+
+  ~TranspositionTable();
+
+  /**
+   * Reallocates the table to use at most 'mb' megabytes and clears it.
+   * The number of buckets is rounded down to a power of two.
+   */
+  void resize(int mb);
+
+  /** Forgets all entries. */
+  void clear();
+
+  /** Marks the start of a new search, so older entries age. */
+  void newSearch()
+    { m_age = (m_age + 1) & 63; }
+
+  /**
+   * Looks up the position 'key'. Returns true and fills 'entry' if it
+   * is in the table.
+   */
+  bool probe(unsigned long long key, TTEntry & entry, TTStats & stats);
+
+  /**
+   * Stores a search result for the position 'key'.
+   * @param depth - The remaining depth the position was searched to.
+   * @param score - The score found.
+   * @param bound - Whether the score is exact or a bound.
+   * @param move - The best move found, may be the null move.
+   */
+  void store(unsigned long long key, int depth, int score, TTEntry::Bound bound,
+             const Move & move, TTStats & stats);
+
+  /** Returns how many of a thousand entries are used by the current search. */
+  int getUsage() const;
+
+  /** Returns the size of the table in bytes. */
+  unsigned long long getSize() const
+    { return (m_mask + 1) * sizeof(Bucket); }
+
+ private:
+  const static int BUCKETSIZE = 4;
+
+  struct Slot {
+    std::atomic<unsigned long long> key;
+    std::atomic<unsigned long long> data;
+  };
+
+  struct Bucket {
+    Slot slots[BUCKETSIZE];
+  };
+
+  static unsigned long long pack(const TTEntry & entry);
+  static TTEntry unpack(unsigned long long data);
+
+  Bucket * m_buckets;
+  unsigned long long m_mask;
+  int m_age;
+};
+
+#endif
+
+// End of file transpositiontable.h
@@ -13,6 +13,7 @@
 #include "options.h"
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <unistd.h>
@@ -86,6 +87,10 @@ void UciPlayer::runChessEngine()
     exit(1);
   }
 
+  close( m_to[0] );
+  close( m_from[1] );
+  m_reader.setFd( m_from[0] );
+
 //  if (m_ply < 9)
 //  {
 //    command = "setoption name Skill Level ";
@@ -98,6 +103,23 @@ void UciPlayer::runChessEngine()
   m_initialized = true;
 }
 
+// Gives up waiting once the engine is silent for a second or gone
+void UciPlayer::stopEngine()
+{
+  const char * line;
+  int length;
+
+  write(m_to[1], "stop\n", 5);
+
+  while (m_reader.readLine(&line, &length, 1000) == EngineReader::LINE)
+  {
+    if (length >= 9 && memcmp(line, "bestmove ", 9) == 0)
+    {
+      break;
+    }
+  }
+}
+
 // Get a move from Uci
 void UciPlayer::think(const ChessGameState & cgs)
 {
@@ -113,27 +135,41 @@ void UciPlayer::think(const ChessGameState & cgs)
   m_is_thinking = true;
 
   string output;
-//  string outputPart;
+  const char * line;
+  int length;
   char c;
-  while ( output.substr(0, 9) != "bestmove ") {
-//    outputPart = output.substr(0, 12);
-//    cout << "*" << outputPart << "*" << endl;
-
-    output = "";
-    while ( read( m_from[0], &c, 1 ) ) {
-      if ( c == '\n' )
-        break;
-      output += c;
+  while (true) {
+    EngineReader::Status status =
+      m_reader.readLine(&line, &length, EngineReader::STOP_CHECK_MS);
+
+    if (status == EngineReader::TIMEOUT)
+    {
+      if (m_is_stop_thinking)
+      {
+        stopEngine();
+        m_is_thinking = false;
+        return;
+      }
+      continue;
     }
-    cout << output << endl;
 
-    if (output == "error")
+    if (status == EngineReader::CLOSED
+        || (length == 5 && memcmp(line, "error", 5) == 0))
     {
       m_initialized = false;
       m_is_thinking = false;
       setStopThinking(true);
       return;
     }
+
+    d1printf("%.*s\n", length, line);
+
+    // Only the line with the move is copied
+    if (length >= 9 && memcmp(line, "bestmove ", 9) == 0)
+    {
+      output.assign(line, length);
+      break;
+    }
   }
   output = output.substr(9, 5);
 
@@ -70,6 +70,7 @@ void printUsage()
   cerr << " -hp  Set highlight piece on." << endl;
   cerr << " -hs  Set highlight square on." << endl;
   cerr << " -shc SQUARE_HIGHLIGHT_COLOR   (45 100 100)" << endl;
+  cerr << " -hh  Set highlight hanging pieces on." << endl;
   cerr << " -ma  Set computer move animation on." << endl;
   cerr << " -mo  Set move arrow on." << endl;
 
@@ -80,6 +81,9 @@ void printUsage()
   cerr << "                -ce Gnuchess xboard /usr/bin/gnuchess" << endl;
   cerr << "                -ce Stockfish uci /usr/bin/stockfish" << endl;
 #endif
+  cerr << " -ob  BOOK_FILE  Set computer player opening book, Polyglot .bin format." << endl;
+  cerr << " -eb  BITBASE_FILE  Set computer player endgame bitbase, generated" << endl;
+  cerr << "      if missing. (nicechess.bitbase)" << endl;
 
   cerr << " -wpt WHITE_PLAYER_TYPE        (Human)" << endl;
   cerr << " -bpt BLACK_PLAYER_TYPE        (Nice)" << endl;
@@ -87,6 +91,17 @@ void printUsage()
   cerr << " -wpd WHITE_PLAYER_DIFFICULTY  (3) (Choices are: 1 - 9)" << endl;
   cerr << " -bpd BLACK_PLAYER_DIFFICULTY  (3) (Choices are: 1 - 9)" << endl;
   cerr << " -mt  TIME_MS  Set minimum computer move time.  (1000)" << endl;
+  cerr << " -tt  SIZE_MB  Set computer player hash table size. (16)" << endl;
+  cerr << " -pt  SIZE_KB  Set computer player pawn hash table size per thread. (256)" << endl;
+  cerr << " -th  THREADS  Set computer player helper search threads." << endl;
+  cerr << "               (" << opts->searchthreads << ", number of CPUs - 1)" << endl;
+  cerr << " -nn  Set computer player null move pruning off." << endl;
+  cerr << " -nl  Set computer player late move reductions off." << endl;
+  cerr << " -nf  Set computer player futility pruning off." << endl;
+  cerr << " -np  Set computer player pondering off." << endl;
+  cerr << " -ss  Print computer player search statistics after every move." << endl;
+  cerr << " -bench DEPTH  Search a fixed set of positions, print node counts and" << endl;
+  cerr << "      search statistics and quit." << endl;
   cerr << endl;
   cerr << "Colors are in HUE SAT. VALUE triplet or in 0xRRGGBB format." << endl;
   cerr << "Hue range:        0 - 360" << endl;
@@ -311,6 +326,8 @@ void parseCommandLine(int argc, char* argv[])
       opts->ishighlightpiece = true;
     } else if(args[i] == "-hs") {
       opts->ishighlightsquare = true;
+    } else if(args[i] == "-hh") {
+      opts->ishighlighthanging = true;
     } else if(args[i] == "-shc") {
       readColor(args, &i, &(opts->squarehighlightcolor), &isok);
     } else if(args[i] == "-ma") {
@@ -338,6 +355,12 @@ void parseCommandLine(int argc, char* argv[])
       i+=3;
 #endif
 
+    } else if(args[i] == "-ob" && numParams(args,i) == 1) {
+      opts->bookfilename = args[i+1];
+      i++;
+    } else if(args[i] == "-eb" && numParams(args,i) == 1) {
+      opts->bitbasefilename = args[i+1];
+      i++;
     } else if(args[i] == "-wpt" && numParams(args,i) == 1) {
       if (
         args[i+1] == "Nice"
@@ -404,6 +427,52 @@ void parseCommandLine(int argc, char* argv[])
       opts->mincomputermovetimems /= 100;
       opts->mincomputermovetimems *= 100;
 
+      i++;
+    } else if(args[i] == "-tt" && numParams(args,i) == 1) {
+      opts->hashsizemb = stoi(args[i+1]);
+
+      if (opts->hashsizemb < 1)
+      {
+        opts->hashsizemb = 1;
+      }
+
+      i++;
+    } else if(args[i] == "-pt" && numParams(args,i) == 1) {
+      opts->pawnhashsizekb = stoi(args[i+1]);
+
+      if (opts->pawnhashsizekb < 1)
+      {
+        opts->pawnhashsizekb = 1;
+      }
+
+      i++;
+    } else if(args[i] == "-th" && numParams(args,i) == 1) {
+      opts->searchthreads = stoi(args[i+1]);
+
+      if (opts->searchthreads < 0)
+      {
+        opts->searchthreads = 0;
+      }
+
+      i++;
+    } else if(args[i] == "-nn") {
+      opts->isnullmove = false;
+    } else if(args[i] == "-nl") {
+      opts->islatemovereduction = false;
+    } else if(args[i] == "-nf") {
+      opts->isfutility = false;
+    } else if(args[i] == "-np") {
+      opts->isponder = false;
+    } else if(args[i] == "-ss") {
+      opts->issearchstats = true;
+    } else if(args[i] == "-bench" && numParams(args,i) == 1) {
+      opts->benchmarkdepth = stoi(args[i+1]);
+
+      if (opts->benchmarkdepth < 1)
+      {
+        opts->benchmarkdepth = 1;
+      }
+
       i++;
     } else {
       isok = false;
@@ -435,6 +504,57 @@ void parseCommandLine(int argc, char* argv[])
   opts->updateColors();
 }
 
+// Positions searched by -bench, the perft test positions and a few
+// middle games and endings
+static const char * benchmarkFens[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+  "2r3k1/pp3ppp/4p3/3pP3/3P4/P4N2/1P3PPP/2R3K1 b - - 0 24",
+  "8/5pk1/6p1/8/3R4/6PP/5PK1/3r4 w - - 0 40",
+  "8/8/3k4/8/2PK4/8/8/8 w - - 0 1",
+};
+
+// Searches every benchmark position to 'depth' plies and prints the
+// node counts. The counts only change when the search does, which makes
+// them handy for telling what a change to the search is worth.
+void runBenchmark(int depth)
+{
+  Options* opts = Options::getInstance();
+  NicePlayer player;
+  NicePlayer::SearchStats total;
+  unsigned int start = SDL_GetTicks();
+
+  cout << "Null move " << (opts->isnullmove ? "on" : "off")
+       << ", late move reductions " << (opts->islatemovereduction ? "on" : "off")
+       << ", futility " << (opts->isfutility ? "on" : "off")
+       << ", depth " << depth << endl;
+
+  for(unsigned int i = 0; i < sizeof(benchmarkFens) / sizeof(benchmarkFens[0]); i++) {
+    ChessGameState cgs;
+
+    cgs.setFen(benchmarkFens[i]);
+    player.newGame();
+
+    unsigned long nodes = player.benchmark(cgs, depth);
+    total.add(player.getStats());
+
+    cout << "Position " << i + 1 << ": " << nodes << " nodes, "
+         << player.getStats().toString() << endl;
+  }
+
+  unsigned int ms = SDL_GetTicks() - start;
+
+  cout << "Total: " << total.nodes << " nodes, " << ms << " ms, "
+       << (ms ? total.nodes * 1000 / ms : 0) << " nodes/s" << endl;
+  cout << "Total: " << total.toString() << endl;
+}
+
 BoardTheme* toBoard(BoardType board)
 {
   if(board == GRANITE) {
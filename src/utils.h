@@ -26,6 +26,8 @@ void parseCommandLine(int argc, char* argv[]);
 
 void printUsage();
 
+void runBenchmark(int depth);
+
 int numParams(const vector<string>& args, int i);
 
 void hsvToRgb(
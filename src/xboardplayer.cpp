@@ -13,6 +13,7 @@
 #include "options.h"
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <unistd.h>
@@ -86,6 +87,10 @@ void XboardPlayer::runChessEngine()
     exit(1);
   }
 
+  close( m_to[0] );
+  close( m_from[1] );
+  m_reader.setFd( m_from[0] );
+
   write( m_to[1], "xboard\n", 7);
   write( m_to[1], "nopost\n", 7);
   write( m_to[1], "easy\n", 5);
@@ -99,6 +104,24 @@ void XboardPlayer::runChessEngine()
   m_initialized = true;
 }
 
+// Gives up waiting once the engine is silent for a second or gone
+void XboardPlayer::stopEngine()
+{
+  const char * line;
+  int length;
+
+  write(m_to[1], "?\n", 2);
+
+  while (m_reader.readLine(&line, &length, 1000) == EngineReader::LINE)
+  {
+    if ((length >= 12 && memcmp(line, "My move is :", 12) == 0)
+        || (length >= 5 && memcmp(line, "move ", 5) == 0))
+    {
+      break;
+    }
+  }
+}
+
 // Get a move from Xboard
 void XboardPlayer::think(const ChessGameState & cgs)
 {
@@ -114,17 +137,26 @@ void XboardPlayer::think(const ChessGameState & cgs)
   m_is_thinking = true;
 
   string output;
+  const char * line;
+  int length;
   char c;
   while (true) {
-    output = "";
-    while ( read( m_from[0], &c, 1 ) ) {
-      if ( c == '\n' )
-        break;
-      output += c;
+    EngineReader::Status status =
+      m_reader.readLine(&line, &length, EngineReader::STOP_CHECK_MS);
+
+    if (status == EngineReader::TIMEOUT)
+    {
+      if (m_is_stop_thinking)
+      {
+        stopEngine();
+        m_is_thinking = false;
+        return;
+      }
+      continue;
     }
-    cout << output << endl;
 
-    if (output == "error")
+    if (status == EngineReader::CLOSED
+        || (length == 5 && memcmp(line, "error", 5) == 0))
     {
       m_initialized = false;
       m_is_thinking = false;
@@ -132,13 +164,18 @@ void XboardPlayer::think(const ChessGameState & cgs)
       return;
     }
 
-    if (output.substr(0, 12) == "My move is :")
+    d1printf("%.*s\n", length, line);
+
+    // Only the line with the move is copied
+    if (length >= 12 && memcmp(line, "My move is :", 12) == 0)
     {
+      output.assign(line, length);
       output = output.substr(12, 5);
       break;
     }
-    else if (output.substr(0, 5) == "move ")
+    else if (length >= 5 && memcmp(line, "move ", 5) == 0)
     {
+      output.assign(line, length);
       output = output.substr(5, 5);
       break;
     }